@@ -3,6 +3,22 @@
 #include "engine/log.h"
 #include "config.h"
 #include "processor_menu.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+// Choices of the speed dropdown, in ticks per second.
+constexpr uint64_t SPEEDS[] = {1000 / TICK_DELAY, 10 * 1000 / TICK_DELAY,
+                               100 * 1000 / TICK_DELAY, 1000 * 1000 / TICK_DELAY,
+                               Simulation::UNLIMITED};
+const std::vector<std::string> SPEED_NAMES = {"1x", "10x", "100x", "1000x", "Max"};
+
+// Problem ports are not connected to the processor, so there is nothing
+// to count outputs or mismatches on yet.
+const std::vector<std::string> RUN_UNTIL_NAMES = {"+1000 ticks", "+1M ticks"};
+
+}
 
 GameState::GameState(std::vector<ProcessorTemplate> temp) : State(), processor{temp[0].instantiate()}, templates{std::move(temp)} {}
 
@@ -19,6 +35,7 @@ void GameState::set_font_size() {
     dpi_scale = new_dpi_scale;
     int hpdi = 72, vdpi = 72;
     TTF_SetFontSizeDPI(gFont, 20, hpdi, vdpi);
+    gGlyphAtlas.set_font(gFont);
     return;
 }
 
@@ -44,10 +61,14 @@ void GameState::init(WindowState *window_state) {
     LOG_INFO("Physical size: %d, %d\n", window_state->window_width, window_state->window_height);
     LOG_INFO("Logical size: %d, %d\n", window_state->screen_width, window_state->screen_height);
 
+    simulation.set_tick_rate(SPEEDS[0]);
+    simulation.attach(&processor, &problem);
+
     processor_gui.~ProcessorGui();
-    new (&processor_gui)ProcessorGui(&processor, &problem, BOX_X, BOX_Y, window_state);
+    new (&processor_gui)ProcessorGui(&processor, &problem, &simulation, BOX_X, BOX_Y, window_state);
 
     void(*proc_cb)(GameState*) = [](GameState* self) {
+        self->simulation.stop();
         self->processor_gui.menu_change(true);
         self->top_comps.enable_hover(false);
         self->next_state.action = StateStatus::PUSH;
@@ -62,12 +83,12 @@ void GameState::init(WindowState *window_state) {
 
     void(*run_pressed)(GameState*) = [](GameState* self) {
         if (self->processor.is_valid()) {
-            if (self->processor.is_running()) {
+            if (self->simulation.is_running()) {
                 self->run_button->set_text("Run");
-                self->processor.stop();
+                self->simulation.stop();
             } else {
                 self->run_button->set_text("Stop");
-                self->processor.start();
+                self->simulation.start();
             }
         }
     };
@@ -79,30 +100,77 @@ void GameState::init(WindowState *window_state) {
     void(*step_pressed)(GameState*) = [](GameState* self) {
         LOG_DEBUG("Step pressed");
         if (self->processor.is_valid()) {
-            self->clock_tick();
+            self->simulation.step();
             self->processor_gui.update();
         }
     };
 
     top_comps.add(Button(BOX_X + BOX_SIZE + 120, BOX_Y + BOX_SIZE + 200, 80, 80, "Step", *window_state), step_pressed, this);
+
+    void(*speed_chosen)(int64_t, GameState*) = [](int64_t ix, GameState* self) {
+        self->simulation.set_tick_rate(SPEEDS[ix]);
+    };
+
+    auto speed = top_comps.add(Dropdown(BOX_X + BOX_SIZE + 80, BOX_Y + 20, 100, 40, "",
+                                        SPEED_NAMES, *window_state), speed_chosen, this);
+    speed->set_choice(0);
+
+    void(*run_until_chosen)(int64_t, GameState*) = [](int64_t ix, GameState* self) {
+        self->run_until->clear_choice();
+        if (!self->processor.is_valid()) {
+            return;
+        }
+        // Stop first, so the current ticks can be read.
+        self->simulation.stop();
+        RunTarget target;
+        target.type = RunTarget::TICKS;
+        target.value = self->processor.get_ticks() + (ix == 0 ? 1000 : 1000000);
+        self->simulation.start(target);
+    };
+
+    run_until = top_comps.add(Dropdown(BOX_X + BOX_SIZE + 200, BOX_Y + 20, 180, 40, "Run until",
+                                       RUN_UNTIL_NAMES, *window_state), run_until_chosen, this);
     next_state.action = StateStatus::NONE;
 
     set_font_size();
 
-    SDL_RWops* file = SDL_RWFromFile("program.txt", "r");
-    if (file != nullptr) {
-        Sint64 size = SDL_RWsize(file);
-        char *data = new char[size];
-        if (SDL_RWread(file, data, 1, size) == size) {
-            std::string str{data, static_cast<std::size_t>(size)};
-            if (str.back() == '\n') {
+    save_path = "program_";
+    for (char c : templates[0].name) {
+        save_path += std::isalnum(static_cast<unsigned char>(c)) || c == '-' ? c : '_';
+    }
+    save_path += ".txt";
+    // Programs used to be saved in a single file for all templates.
+    if (!load_program_text(save_path)) {
+        load_program_text("program.txt");
+    }
+    saved_edits = seen_edits = processor_gui.get_edit_count();
+}
+
+bool GameState::load_program_text(const std::string &path) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    Sint64 size = SDL_RWsize(file);
+    bool ok = size >= 0;
+    if (ok) {
+        std::string str(static_cast<std::size_t>(size), '\0');
+        ok = SDL_RWread(file, str.data(), 1, size) == size;
+        if (ok) {
+            if (!str.empty() && str.back() == '\n') {
                 str.pop_back();
             }
             processor_gui.set_edit_text(str);
         }
-        delete[] data;
-        SDL_RWclose(file);
     }
+    SDL_RWclose(file);
+    return ok;
+}
+
+void GameState::save_program_text() {
+    autosaver.save(save_path, std::make_shared<const std::vector<std::string>>(
+                                  processor_gui.get_edit_text()));
+    saved_edits = seen_edits;
 }
 
 void GameState::resume() {
@@ -114,55 +182,69 @@ void GameState::resume() {
 
     processor_gui.set_processor(&processor);
     problem.reset();
-}
-
-void GameState::clock_tick() {
-    problem.in_tick();
-    processor.in_tick();
-
-    problem.out_tick();
-    processor.out_tick();
-
-    processor.clock_tick();
+    simulation.sync();
 }
 
 void GameState::render() {
     processor_gui.render();
     top_comps.render(0, 0);
 }
+
+bool GameState::is_dirty() const {
+    return processor_gui.is_dirty() || top_comps.is_dirty();
+}
+
+int GameState::idle_timeout() const {
+    if (simulation.is_running()) {
+        // Wake for the next snapshot, at most once per frame.
+        uint64_t rate = simulation.get_tick_rate();
+        if (rate == Simulation::UNLIMITED || rate >= 1000 / FRAME_DELAY) {
+            return FRAME_DELAY;
+        }
+        return static_cast<int>(1000 / rate);
+    }
+    int timeout = processor_gui.idle_timeout();
+    if (seen_edits != saved_edits) {
+        Uint64 passed = SDL_GetTicks64() - edit_time;
+        int save_in = passed >= AUTOSAVE_DELAY ? 0 : AUTOSAVE_DELAY - static_cast<int>(passed);
+        if (timeout < 0 || save_in < timeout) {
+            timeout = save_in;
+        }
+    }
+    return timeout;
+}
+
 void GameState::tick(const Uint64 delta, StateStatus &res) {
     res = next_state;
     if (next_state.will_leave()) {
+        simulation.stop();
         LOG_DEBUG("Saving...");
-        SDL_RWops* file = SDL_RWFromFile("program.txt", "w");
-        if (file != nullptr) {
-            const auto& lines = processor_gui.get_edit_text();
-            for (const std::string& s : lines) {
-                SDL_RWwrite(file, s.c_str(), 1, s.size());
-                SDL_RWwrite(file, "\n", 1, 1);
-            }
-            SDL_RWclose(file);
-        }
+        save_program_text();
+        autosaver.flush();
         return;
     }
 
     processor_gui.tick(delta);
+    processor_gui.update();
 
-    if (processor.is_running()) {
-        ticks_passed += delta;
-        while (ticks_passed > TICK_DELAY) {
-            clock_tick();
-            ticks_passed -= TICK_DELAY;
-        }
+    // Save once edits have settled, on the autosave thread.
+    uint64_t edits = processor_gui.get_edit_count();
+    if (edits != seen_edits) {
+        seen_edits = edits;
+        edit_time = SDL_GetTicks64();
+    }
+    if (seen_edits != saved_edits && SDL_GetTicks64() - edit_time >= AUTOSAVE_DELAY) {
+        save_program_text();
     }
 
-    if (processor.is_running()) {
-        if (run_button->get_text()[0] != 'S') {
+    // Read through a const handle, so idle frames are not marked dirty.
+    const auto &button = run_button;
+    if (simulation.is_running()) {
+        if (button->get_text()[0] != 'S') {
             run_button->set_text("Stop");
         }
-        processor_gui.update();
     } else {
-        if (run_button->get_text()[0] != 'R') {
+        if (button->get_text()[0] != 'R') {
             run_button->set_text("Run");
         }
     }
@@ -185,9 +267,11 @@ void GameState::handle_down(const SDL_Keycode key, const Uint8 mouse) {
     } else if (mouse == SDL_BUTTON_LEFT) {
         if (processor_gui.is_pressed(window_state->mouseX, window_state->mouseY)) {
             SDL_StartTextInput();
+            simulation.stop();
             processor_gui.set_selected(true);
             processor.invalidate();
             problem.reset();
+            simulation.sync();
         } else {
             mouse_down = true;
             processor_gui.set_selected(false);
@@ -209,6 +293,12 @@ void GameState::handle_textinput(const SDL_TextInputEvent &e) {
     processor_gui.input_char(c);
 }
 
+void GameState::handle_wheel(const SDL_MouseWheelEvent &e) {
+    if (processor_gui.is_pressed(window_state->mouseX, window_state->mouseY)) {
+        processor_gui.scroll(-3 * e.y);
+    }
+}
+
 void GameState::handle_focus_change(bool focus) {
     if (!focus) {
         processor_gui.set_selected(false);
@@ -1,8 +1,10 @@
 #pragma once
+#include "autosave.h"
 #include "editbox.h"
 #include "problem.h"
 #include "processor.h"
 #include "processor_gui.h"
+#include "simulation.h"
 #include <engine/game.h>
 #include <engine/ui.h>
 
@@ -19,6 +21,10 @@ public:
 
     void render() override;
 
+    bool is_dirty() const override;
+
+    int idle_timeout() const override;
+
     void tick(Uint64 delta, StateStatus &res) override;
 
     void handle_down(SDL_Keycode key, Uint8 mouse) override;
@@ -27,32 +33,49 @@ public:
 
     void handle_textinput(const SDL_TextInputEvent &e) override;
 
+    void handle_wheel(const SDL_MouseWheelEvent &e) override;
+
     void handle_size_change() override;
 
     void handle_focus_change(bool focus) override;
 
     void menu_change(bool visible);
 
-    void clock_tick();
 private:
     StateStatus next_state;
 
     void set_font_size();
 
+    // Loads the program text from path, returns false if there is none.
+    bool load_program_text(const std::string& path);
+
+    // Hands the current program text to the autosaver.
+    void save_program_text();
+
     bool should_exit = false;
 
     bool mouse_down = false;
 
     Processor processor;
     ByteProblem problem {};
+    // Declared after processor and problem, so it stops before they are destroyed.
+    Simulation simulation {};
     ProcessorGui processor_gui{};
 
     Components top_comps;
     Component<Button> run_button;
+    Component<Dropdown> run_until;
 
-    Uint64 ticks_passed = 0;
 
     double dpi_scale = 0.0;
 
+    Autosaver autosaver {};
+    // Save slot of the current processor template.
+    std::string save_path {};
+    // Edit count of the last save and of the last seen edit.
+    uint64_t saved_edits {0};
+    uint64_t seen_edits {0};
+    Uint64 edit_time {0};
+
     std::vector<ProcessorTemplate> templates;
 };
@@ -0,0 +1,101 @@
+#include "autosave.h"
+#include "engine/log.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+bool write_file_atomic(const std::string &path, const std::string &data) {
+    std::string tmp_path = path + ".tmp";
+    FILE *file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        LOG_WARNING("Failed opening %s", tmp_path.c_str());
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = std::fflush(file) == 0 && ok;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+#ifdef _WIN32
+        ok = MoveFileExA(tmp_path.c_str(), path.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        ok = std::rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+    }
+    if (!ok) {
+        LOG_WARNING("Failed writing %s", path.c_str());
+        std::remove(tmp_path.c_str());
+    }
+    return ok;
+}
+
+Autosaver::~Autosaver() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stop = true;
+    }
+    cond.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Autosaver::save(const std::string &path,
+                     std::shared_ptr<const std::vector<std::string>> lines) {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending[path] = std::move(lines);
+        if (!thread.joinable()) {
+            thread = std::thread{&Autosaver::run, this};
+        }
+    }
+    cond.notify_one();
+}
+
+void Autosaver::flush() {
+    std::unique_lock<std::mutex> lock{mutex};
+    done_cond.wait(lock, [this]() { return pending.empty() && !writing; });
+}
+
+void Autosaver::run() {
+    std::string data{};
+    while (true) {
+        std::string path;
+        std::shared_ptr<const std::vector<std::string>> lines;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            writing = false;
+            done_cond.notify_all();
+            cond.wait(lock, [this]() { return stop || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            auto it = pending.begin();
+            path = it->first;
+            lines = std::move(it->second);
+            pending.erase(it);
+            writing = true;
+        }
+
+        data.clear();
+        for (const std::string &line : *lines) {
+            data += line;
+            data += '\n';
+        }
+        if (write_file_atomic(path, data)) {
+            LOG_DEBUG("Saved %s", path.c_str());
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef PROC_ASM_AUTOSAVE_H
+#define PROC_ASM_AUTOSAVE_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes data to path through a temporary file that is synced and then
+ * renamed over path, so a crash leaves either the old or the new content.
+ *
+ * @return false if any step failed, path is then unchanged.
+ */
+bool write_file_atomic(const std::string& path, const std::string& data);
+
+/**
+ * Saves text files on a background thread.
+ * Only the latest submitted lines of each path are written, older saves
+ * that have not started are dropped. Saves still queued are written
+ * before the destructor returns.
+ */
+class Autosaver {
+public:
+    Autosaver() = default;
+
+    Autosaver(const Autosaver&) = delete;
+    Autosaver& operator=(const Autosaver&) = delete;
+
+    ~Autosaver();
+
+    /**
+     * Queues lines to be written to path, one per line.
+     * The thread is started on first use.
+     */
+    void save(const std::string& path, std::shared_ptr<const std::vector<std::string>> lines);
+
+    /**
+     * Waits until all queued saves are written.
+     */
+    void flush();
+
+private:
+    void run();
+
+    std::thread thread {};
+    std::mutex mutex {};
+    std::condition_variable cond {};
+    std::condition_variable done_cond {};
+
+    std::map<std::string, std::shared_ptr<const std::vector<std::string>>> pending {};
+    bool writing = false;
+
+    bool stop = false;
+};
+
+#endif
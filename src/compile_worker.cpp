@@ -0,0 +1,88 @@
+#include "compile_worker.h"
+#include "engine/log.h"
+#include "engine/game.h"
+
+CompileResult run_compile_job(CompileJob &job) {
+    CompileResult res{};
+    res.generation = job.generation;
+    Compiler c{job.registers, std::move(job.ports), res.instructions,
+               job.instruction_set, job.features};
+    res.valid = c.compile(*job.lines, res.errors);
+    return res;
+}
+
+CompileWorker::~CompileWorker() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stop = true;
+    }
+    cond.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+uint64_t CompileWorker::submit(CompileJob job) {
+    uint64_t gen = ++generation;
+    job.generation = gen;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending = std::move(job);
+        finished.reset();
+        if (!thread.joinable()) {
+            thread = std::thread{&CompileWorker::run, this};
+        }
+    }
+    cond.notify_one();
+    return gen;
+}
+
+void CompileWorker::cancel() {
+    ++generation;
+    std::lock_guard<std::mutex> lock{mutex};
+    pending.reset();
+    finished.reset();
+}
+
+bool CompileWorker::poll(CompileResult &result) {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (!finished.has_value()) {
+        return false;
+    }
+    bool current = finished->generation == generation;
+    if (current) {
+        result = std::move(*finished);
+    }
+    finished.reset();
+    return current;
+}
+
+void CompileWorker::run() {
+    while (true) {
+        std::optional<CompileJob> job;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            cond.wait(lock, [this]() { return stop || pending.has_value(); });
+            if (stop) {
+                return;
+            }
+            job = std::move(pending);
+            pending.reset();
+        }
+        if (job->generation != generation) {
+            continue;
+        }
+
+        CompileResult res = run_compile_job(*job);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        if (res.generation == generation) {
+            finished = std::move(res);
+            // The game loop might be waiting for events.
+            wake_game_loop();
+        } else {
+            LOG_DEBUG_CAT(LogCategory::COMPILER, "Dropping stale compile result %llu",
+                          static_cast<unsigned long long>(res.generation));
+        }
+    }
+}
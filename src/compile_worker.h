@@ -0,0 +1,94 @@
+#ifndef PROC_ASM_COMPILE_WORKER_H
+#define PROC_ASM_COMPILE_WORKER_H
+
+#include "compiler.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/**
+ * Everything needed to compile a program, detached from the processor it
+ * came from so it can be handed to another thread.
+ */
+struct CompileJob {
+    uint64_t generation {0};
+
+    // Immutable snapshot of the editor lines.
+    std::shared_ptr<const std::vector<std::string>> lines;
+
+    RegisterFile registers;
+    std::vector<std::string> ports;
+    InstructionSet instruction_set;
+    feature_t features;
+};
+
+/**
+ * Output of a CompileJob.
+ */
+struct CompileResult {
+    uint64_t generation {0};
+
+    bool valid {false};
+    std::vector<Instruction> instructions {};
+    std::vector<ErrorMsg> errors {};
+};
+
+/**
+ * Compiles job on the calling thread.
+ */
+CompileResult run_compile_job(CompileJob& job);
+
+/**
+ * Runs CompileJobs on a background thread.
+ * Only the latest submitted job is relevant, older jobs that have not
+ * started are dropped and results of older generations are discarded.
+ */
+class CompileWorker {
+public:
+    CompileWorker() = default;
+
+    CompileWorker(const CompileWorker&) = delete;
+    CompileWorker& operator=(const CompileWorker&) = delete;
+
+    ~CompileWorker();
+
+    /**
+     * Queues a job, replacing any job not yet started.
+     * The thread is started on first use.
+     *
+     * @return the generation assigned to the job.
+     */
+    uint64_t submit(CompileJob job);
+
+    /**
+     * Marks all submitted jobs as stale, so their results are never returned.
+     */
+    void cancel();
+
+    /**
+     * Fetches the result of the latest job, if it has finished.
+     *
+     * @param result filled with the result if one is available.
+     * @return true if result was filled.
+     */
+    bool poll(CompileResult& result);
+
+private:
+    void run();
+
+    std::thread thread {};
+    std::mutex mutex {};
+    std::condition_variable cond {};
+
+    std::atomic<uint64_t> generation {0};
+
+    std::optional<CompileJob> pending {};
+    std::optional<CompileResult> finished {};
+
+    bool stop = false;
+};
+
+#endif
@@ -378,14 +378,18 @@ Instruction Compiler::parse(
     return {type, out_operands};
 };
 
-/*
- * Divides a line into parts split on ',', ' ' and '\t'.
- * Ignores labels and comments.
- */
-std::vector<std::pair<std::size_t, std::size_t>> split(const std::string &s,
-                                                       std::size_t &label_end) {
+std::vector<std::pair<std::size_t, std::size_t>> split_line(const std::string &s,
+                                                            std::size_t &label_end) {
+    std::size_t comment_start;
+    return split_line(s, label_end, comment_start);
+}
+
+std::vector<std::pair<std::size_t, std::size_t>> split_line(const std::string &s,
+                                                            std::size_t &label_end,
+                                                            std::size_t &comment_start) {
     std::vector<std::pair<std::size_t, std::size_t>> res{};
     std::size_t end_ix = s.find_last_of(";#");
+    comment_start = end_ix;
 
     std::size_t start_ix = s.find(':');
     if (start_ix == std::string::npos || start_ix > end_ix) {
@@ -412,6 +416,54 @@ std::vector<std::pair<std::size_t, std::size_t>> split(const std::string &s,
     }
 }
 
+SyntaxTable::SyntaxTable(const RegisterFile &registers,
+                         std::vector<std::string> ports,
+                         const InstructionSet &instruction_set)
+    : ports{std::move(ports)}, instruction_set{instruction_set} {
+    for (uint64_t i = 0; i < registers.count_genreg(); ++i) {
+        this->registers.push_back(registers.to_name_genreg(i));
+    }
+}
+
+void SyntaxTable::lex_line(const std::string &line,
+                           std::vector<Token> &tokens) const {
+    tokens.clear();
+    std::size_t label_size;
+    std::size_t comment;
+    auto parts = split_line(line, label_size, comment);
+    if (label_size > 0) {
+        tokens.push_back({0, label_size, TokenKind::LABEL});
+    }
+    std::string part{};
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        part.assign(line, parts[i].first, parts[i].second);
+        for (auto &c : part) {
+            c = std::toupper(c);
+        }
+        TokenKind kind;
+        uint64_t val;
+        DataSize size;
+        if (i == 0) {
+            if (instruction_set.find(part) == instruction_set.end()) {
+                continue;
+            }
+            kind = TokenKind::MNEMONIC;
+        } else if (std::find(registers.begin(), registers.end(), part) != registers.end()) {
+            kind = TokenKind::REGISTER;
+        } else if (std::find(ports.begin(), ports.end(), part) != ports.end()) {
+            kind = TokenKind::PORT;
+        } else if (read_gint(part, size, val)) {
+            kind = TokenKind::NUMBER;
+        } else {
+            kind = TokenKind::LABEL;
+        }
+        tokens.push_back({parts[i].first, parts[i].second, kind});
+    }
+    if (comment != std::string::npos) {
+        tokens.push_back({comment, line.size() - comment, TokenKind::COMMENT});
+    }
+}
+
 ErrorMsg::ErrorMsg(std::string msg, TextPosition pos)
     : msg{std::move(msg)}, pos{pos}, empty{false} {}
 
@@ -432,7 +484,7 @@ bool Compiler::compile(const std::vector<std::string> &lines,
     for (auto &line : lines) {
         ++row;
         std::size_t label_size;
-        auto parts = split(line, label_size);
+        auto parts = split_line(line, label_size);
         if (parts.size() > 0) {
             ++instruction_count;
         }
@@ -465,14 +517,17 @@ bool Compiler::compile(const std::vector<std::string> &lines,
         }
     }
     row = -1;
-    LOG_DEBUG("Size: %d", instruction_set.size());
-    for (auto &s : instruction_set) {
-        LOG_DEBUG("INST: %s", s.first.c_str());
+    if (LOG_DEBUG_ENABLED(LogCategory::COMPILER)) {
+        LOG_DEBUG_CAT(LogCategory::COMPILER, "Size: %llu",
+                      static_cast<unsigned long long>(instruction_set.size()));
+        for (auto &s : instruction_set) {
+            LOG_DEBUG_CAT(LogCategory::COMPILER, "INST: %s", s.first.c_str());
+        }
     }
     for (auto &line : lines) {
         ++row;
         std::size_t label_size;
-        auto parts = split(line, label_size);
+        auto parts = split_line(line, label_size);
         if (parts.size() == 0) {
             continue;
         }
@@ -480,7 +535,7 @@ bool Compiler::compile(const std::vector<std::string> &lines,
         for (auto &c : instr) {
             c = std::toupper(c);
         }
-        LOG_DEBUG("I: %s", instr.c_str());
+        LOG_DEBUG_CAT(LogCategory::COMPILER, "I: %s", instr.c_str());
         auto val = instruction_set.find(instr);
         if (val == instruction_set.end()) {
             errors.emplace_back(
@@ -500,24 +555,26 @@ bool Compiler::compile(const std::vector<std::string> &lines,
         }
         i.line = row;
         res.push_back(i);
-        char out[256];
-        char *base = out;
-        base = base + sprintf(base, "%d: ", static_cast<int>(i.id));
-        for (int ix = 0; ix < MAX_OPERANDS; ++ix) {
-            if (i.operands[ix].type == GEN_REG) {
-                base = base + sprintf(base, "r%llu, ", i.operands[ix].reg);
-            } else if (i.operands[ix].type == GEN_IMM) {
-                base = base + sprintf(base, "%llu, ", i.operands[ix].imm_u);
-            } else if (i.operands[ix].type == LABEL) {
-                base = base + sprintf(base, "%d, ", i.operands[ix].label);
-            } else if (i.operands[ix].type == PORT) {
-                base = base + sprintf(base, "%s, ",
-                                      ports[i.operands[ix].port].c_str());
-            } else {
-                break;
+        if (LOG_DEBUG_ENABLED(LogCategory::COMPILER)) {
+            char out[256];
+            char *base = out;
+            base = base + sprintf(base, "%d: ", static_cast<int>(i.id));
+            for (int ix = 0; ix < MAX_OPERANDS; ++ix) {
+                if (i.operands[ix].type == GEN_REG) {
+                    base = base + sprintf(base, "r%llu, ", i.operands[ix].reg);
+                } else if (i.operands[ix].type == GEN_IMM) {
+                    base = base + sprintf(base, "%llu, ", i.operands[ix].imm_u);
+                } else if (i.operands[ix].type == LABEL) {
+                    base = base + sprintf(base, "%d, ", i.operands[ix].label);
+                } else if (i.operands[ix].type == PORT) {
+                    base = base + sprintf(base, "%s, ",
+                                          ports[i.operands[ix].port].c_str());
+                } else {
+                    break;
+                }
             }
+            LOG_DEBUG_CAT(LogCategory::COMPILER, "%s", out);
         }
-        LOG_DEBUG("%s", out);
     }
     if (errors.size() > 0) {
         return false;
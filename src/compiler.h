@@ -43,6 +43,56 @@ typedef std::map<std::string, InstructionSlotType> InstructionSet;
 
 extern const InstructionSet ALL_INSTRUCTIONS;
 
+/*
+ * Divides a line into parts split on ',', ' ' and '\t'.
+ * Ignores labels and comments. label_end is set to the size of the label,
+ * or 0 if there is none. comment_start is set to where the comment starts,
+ * or std::string::npos if there is none.
+ */
+std::vector<std::pair<std::size_t, std::size_t>> split_line(const std::string &s,
+                                                            std::size_t &label_end,
+                                                            std::size_t &comment_start);
+
+std::vector<std::pair<std::size_t, std::size_t>> split_line(const std::string &s,
+                                                            std::size_t &label_end);
+
+enum class TokenKind {
+    MNEMONIC, REGISTER, PORT, LABEL, NUMBER, COMMENT
+};
+
+/**
+ * A classified part of a source line. Comments are added last, and may
+ * overlap earlier tokens.
+ */
+struct Token {
+    std::size_t start;
+    std::size_t size;
+    TokenKind kind;
+};
+
+/**
+ * Classifies the parts of source lines for highlighting, using the same
+ * split as the compiler. Lines are lexed independently of each other.
+ */
+class SyntaxTable {
+public:
+    SyntaxTable() = default;
+
+    SyntaxTable(const RegisterFile& registers, std::vector<std::string> ports,
+                const InstructionSet& instruction_set);
+
+    /**
+     * Replaces tokens with the known parts of line. Unknown mnemonics are
+     * left out, operands that are nothing else are labels.
+     */
+    void lex_line(const std::string& line, std::vector<Token>& tokens) const;
+
+private:
+    std::vector<std::string> registers {};
+    std::vector<std::string> ports {};
+    InstructionSet instruction_set {};
+};
+
 
 class Compiler {
 public:
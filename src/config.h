@@ -4,11 +4,26 @@
 // Milliseconds per clock cycle.
 constexpr int TICK_DELAY = 2;
 
+// Milliseconds per frame while a simulation is running.
+constexpr int FRAME_DELAY = 16;
+
+// Milliseconds without edits before the program is saved.
+constexpr int AUTOSAVE_DELAY = 1000;
+
 #define TEXT_COLOR 0xf0, 0xf0, 0xf0, 0xff
 
+// Syntax highlighting in the edit box.
+#define SYNTAX_MNEMONIC_COLOR 0x6c, 0xb0, 0xf0, 0xff
+#define SYNTAX_REGISTER_COLOR 0xe0, 0xc0, 0x70, 0xff
+#define SYNTAX_PORT_COLOR 0xd0, 0x90, 0xe0, 0xff
+#define SYNTAX_LABEL_COLOR 0x80, 0xd0, 0xc0, 0xff
+#define SYNTAX_NUMBER_COLOR 0xb0, 0xe0, 0x90, 0xff
+#define SYNTAX_COMMENT_COLOR 0x80, 0x80, 0x80, 0xff
+
 constexpr int WIDTH = 1920, HEIGHT = 1080;
 
 constexpr int MAX_LINE_WIDTH = 24;
+// Equal to BOX_VISIBLE_ROWS, so edit boxes only scroll once this is raised.
 constexpr int MAX_LINES = 16;
 
 
@@ -18,7 +33,10 @@ constexpr int BOX_Y = HEIGHT / 2 - BOX_SIZE / 2;
 constexpr int BOX_TEXT_MARGIN = 16;
 constexpr int BOX_LINE_HEIGHT = 20;
 constexpr int BOX_CHAR_WIDTH = 8;
-constexpr int BOX_UNDO_BUFFER_SIZE = 1024;
+// Rows of text visible in an edit box at once.
+constexpr int BOX_VISIBLE_ROWS = 16;
+// Bytes of history kept by each of the undo and redo stacks.
+constexpr int BOX_UNDO_BUFFER_BYTES = 1 << 20;
 
 constexpr int SPACES_PER_TAB = 4;
 
@@ -2,6 +2,8 @@
 #include "config.h"
 #include "engine/log.h"
 #include "engine/style.h"
+#include "engine/text_pass.h"
+#include <algorithm>
 
 bool valid_char(unsigned char c) { return c >= 0x20 && c <= 0xef; }
 
@@ -9,12 +11,12 @@ Editbox::Editbox(int x, int y, const WindowState &window_state)
     : x(x), y(y), window_state(&window_state) {}
 
 TextPosition Editbox::find_pos(int mouse_x, int mouse_y) const {
-    int row = (mouse_y - (y + BOX_TEXT_MARGIN)) / BOX_LINE_HEIGHT;
+    int64_t row = first_row + (mouse_y - (y + BOX_TEXT_MARGIN)) / BOX_LINE_HEIGHT;
     const std::vector<std::string> &text = lines.get_lines();
     if (row < 0) {
         row = 0;
     } else if (row >= text.size()) {
-        row = static_cast<int>(text.size() - 1);
+        row = static_cast<int64_t>(text.size() - 1);
     }
     int col = (mouse_x - (x + BOX_TEXT_MARGIN)) / BOX_CHAR_WIDTH;
     if (col < 0) {
@@ -31,6 +33,7 @@ void Editbox::input_char(char c) {
     }
 
     if (valid_char(c)) {
+        dirty = true;
         reset_cursor_animation();
         if (insert_mode && !lines.has_selection()) {
             TextPosition pos = lines.get_cursor_pos();
@@ -46,24 +49,39 @@ void Editbox::input_char(char c) {
 void Editbox::tick(Uint64 passed) {
     if ((window_state->mouse_mask & SDL_BUTTON_LMASK) && box_selected) {
         TextPosition pos = find_pos(window_state->mouseX, window_state->mouseY);
+        TextPosition old_cursor = lines.get_cursor_pos();
         lines.move_cursor(pos, true);
+        if (lines.get_cursor_pos() != old_cursor) {
+            dirty = true;
+            scroll_to_cursor();
+        }
     }
 
     ticks_remaining -= static_cast<Sint64>(passed);
     if (box_selected && ticks_remaining < 0) {
         ticks_remaining = 500;
         show_cursor = !show_cursor;
+        dirty = true;
     }
 }
 
+int Editbox::idle_timeout() const {
+    if (!box_selected) {
+        return -1;
+    }
+    return ticks_remaining < 0 ? 0 : static_cast<int>(ticks_remaining) + 1;
+}
+
 void Editbox::select() {
     TextPosition pos = find_pos(window_state->mouseX, window_state->mouseY);
     box_selected = true;
+    dirty = true;
     bool shift_pressed = window_state->keyboard_state[SDL_SCANCODE_RSHIFT] ||
                          window_state->keyboard_state[SDL_SCANCODE_LSHIFT];
 
     lines.move_cursor(pos, shift_pressed);
     max_col = lines.get_cursor_pos().col;
+    scroll_to_cursor();
 
     show_cursor = true;
     ticks_remaining = 800;
@@ -72,6 +90,7 @@ void Editbox::select() {
 void Editbox::unselect() {
     box_selected = false;
     show_cursor = false;
+    dirty = true;
     lines.clear_action();
 }
 
@@ -81,51 +100,164 @@ void Editbox::reset_cursor_animation() {
 }
 
 void validate_string(std::string &s) {
-    while (true) {
-        size_t pos = s.find("\r\n");
-        if (pos == std::string::npos) {
-            break;
+    std::string res{};
+    res.reserve(s.size());
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '\t') {
+            res.append(SPACES_PER_TAB, ' ');
+        } else if (c == '\r') {
+            // A run of '\r' ending in "\r\n" is a single line break,
+            // otherwise each '\r' is one.
+            std::size_t end = s.find_first_not_of('\r', i);
+            if (end != std::string::npos && s[end] == '\n') {
+                res += '\n';
+            } else {
+                end = end == std::string::npos ? s.size() : end;
+                res.append(end - i, '\n');
+                --end;
+            }
+            i = end;
+        } else if (c == '\n' || valid_char(c)) {
+            res += c;
         }
-        s.erase(pos, 1);
     }
+    s.swap(res);
+}
+
+void Editbox::set_text(std::string &text) {
+    validate_string(text);
+    dirty = true;
+    lines.set_text(text);
+}
+
+void Editbox::set_errors(std::vector<ErrorMsg> msgs) {
+    dirty = true;
+    errors = std::move(msgs);
+    refresh_errors();
+}
 
-    for (int i = 0; i < s.size();) {
-        if (s[i] == '\t') {
-            s[i] = ' ';
-            for (int j = 0; j < SPACES_PER_TAB - 1; ++j) {
-                s.insert(s.begin() + i + j, ' ');
+void Editbox::refresh_errors() {
+    // Reuse existing boxes, only messages that changed need a new texture.
+    std::size_t count = 0;
+    for (const auto &error : errors) {
+        int64_t row = error.pos.row - first_row;
+        if (row < 0 || row >= BOX_VISIBLE_ROWS) {
+            continue;
+        }
+        int y = BOX_TEXT_MARGIN + static_cast<int>(row) * BOX_LINE_HEIGHT;
+        if (count < error_msg.size()) {
+            error_msg[count].set_position(-24 - BOX_TEXT_MARGIN, y);
+            if (error_msg[count].get_text() != error.msg) {
+                error_msg[count].set_text(error.msg);
             }
-            i += SPACES_PER_TAB;
-        } else if (s[i] == '\r') {
-            s[i] = '\n';
-            ++i;
-        } else if (s[i] != '\n' && !valid_char(s[i])) {
-            s.erase(i, 1);
         } else {
-            ++i;
+            error_msg.emplace_back(-24 - BOX_TEXT_MARGIN, y, 0, BOX_LINE_HEIGHT,
+                                   error.msg, *window_state);
+            error_msg.back().set_align(Alignment::RIGHT);
+            error_msg.back().set_text_color(0xf0, 0, 0, 0xff);
         }
+        ++count;
+    }
+    if (error_msg.size() > count) {
+        error_msg.resize(count);
     }
 }
 
-void Editbox::set_text(std::string &text) {
-    validate_string(text);
-    lines.set_selection(
-        {0, 0},
-        {lines.line_count() - 1, lines.line_size(lines.line_count() - 1)},
-        true);
-    lines.insert_str(text);
-    lines.clear_undo_stack();
+void Editbox::scroll(int64_t rows) {
+    set_first_row(first_row + rows);
 }
 
-void Editbox::set_errors(std::vector<ErrorMsg> msgs) {
-    error_msg.clear();
-    for (const auto &error : msgs) {
-        error_msg.emplace_back(
-            -24 - BOX_TEXT_MARGIN,
-            BOX_TEXT_MARGIN + static_cast<int>(error.pos.row) * BOX_LINE_HEIGHT,
-            0, BOX_LINE_HEIGHT, error.msg, *window_state);
-        error_msg.back().set_align(Alignment::RIGHT);
-        error_msg.back().set_text_color(0xf0, 0, 0, 0xff);
+void Editbox::scroll_to_cursor() {
+    int64_t row = lines.get_cursor_pos().row;
+    if (row < first_row) {
+        set_first_row(row);
+    } else if (row >= first_row + BOX_VISIBLE_ROWS) {
+        set_first_row(row - BOX_VISIBLE_ROWS + 1);
+    } else {
+        set_first_row(first_row);
+    }
+}
+
+void Editbox::set_first_row(int64_t row) {
+    int64_t max_row = std::max<int64_t>(lines.line_count() - BOX_VISIBLE_ROWS, 0);
+    row = std::clamp<int64_t>(row, 0, max_row);
+    if (row == first_row) {
+        return;
+    }
+    first_row = row;
+    dirty = true;
+    refresh_rows(first_row, first_row + BOX_VISIBLE_ROWS - 1);
+    refresh_errors();
+}
+
+void Editbox::set_syntax(SyntaxTable table) {
+    syntax = std::move(table);
+    dirty = true;
+    lex_rows(0, lines.line_count() - 1);
+    refresh_rows(first_row, first_row + BOX_VISIBLE_ROWS - 1, true);
+}
+
+namespace {
+
+SDL_Color token_color(TokenKind kind) {
+    switch (kind) {
+    case TokenKind::MNEMONIC:
+        return {SYNTAX_MNEMONIC_COLOR};
+    case TokenKind::REGISTER:
+        return {SYNTAX_REGISTER_COLOR};
+    case TokenKind::PORT:
+        return {SYNTAX_PORT_COLOR};
+    case TokenKind::LABEL:
+        return {SYNTAX_LABEL_COLOR};
+    case TokenKind::NUMBER:
+        return {SYNTAX_NUMBER_COLOR};
+    case TokenKind::COMMENT:
+    default:
+        return {SYNTAX_COMMENT_COLOR};
+    }
+}
+
+}
+
+void Editbox::lex_rows(int64_t start, int64_t end) {
+    for (int64_t row = start; row <= end; ++row) {
+        const std::string &line = lines.get_lines()[row];
+        std::vector<SDL_Color> &colors = row_colors[row];
+        syntax.lex_line(line, tokens);
+        if (tokens.empty()) {
+            colors.clear();
+            continue;
+        }
+        colors.assign(line.size(), SDL_Color{UI_TEXT_COLOR});
+        for (const Token &token : tokens) {
+            std::fill_n(colors.begin() + token.start, token.size,
+                        token_color(token.kind));
+        }
+    }
+}
+
+void Editbox::refresh_rows(int64_t start, int64_t end, bool force) {
+    if (boxes.empty()) {
+        for (int i = 0; i < BOX_VISIBLE_ROWS; ++i) {
+            boxes.emplace_back(0, BOX_LINE_HEIGHT * i,
+                               BOX_SIZE - 2 * BOX_TEXT_MARGIN, BOX_LINE_HEIGHT,
+                               "", *window_state);
+            boxes.back().set_align(Alignment::LEFT);
+        }
+    }
+    static const std::string empty{};
+    static const std::vector<SDL_Color> no_colors{};
+    start = std::max(start, first_row);
+    end = std::min<int64_t>(end, first_row + BOX_VISIBLE_ROWS - 1);
+    for (int64_t row = start; row <= end; ++row) {
+        bool exists = row < lines.line_count();
+        const std::string &text = exists ? lines.get_lines()[row] : empty;
+        TextBox &box = boxes[row - first_row];
+        // Colors only change with the text, unless the syntax changed.
+        if (force || box.get_text() != text) {
+            box.set_text(text, exists ? row_colors[row] : no_colors);
+        }
     }
 }
 
@@ -149,6 +281,7 @@ void Editbox::handle_keypress(SDL_Keycode key) {
     if (!box_selected) {
         return;
     }
+    dirty = true;
     bool shift_pressed = window_state->keyboard_state[SDL_SCANCODE_RSHIFT] ||
                          window_state->keyboard_state[SDL_SCANCODE_LSHIFT];
     bool ctrl_pressed = window_state->keyboard_state[SDL_SCANCODE_LCTRL] ||
@@ -157,7 +290,7 @@ void Editbox::handle_keypress(SDL_Keycode key) {
     TextPosition cursor = lines.get_cursor_pos();
     if (key == SDLK_INSERT) {
         insert_mode = !insert_mode;
-        LOG_DEBUG("Insert mode: %d", insert_mode);
+        LOG_DEBUG_CAT(LogCategory::EDITOR, "Insert mode: %d", insert_mode);
     } else if (key == SDLK_HOME) {
         reset_cursor_animation();
         if (ctrl_pressed) {
@@ -214,7 +347,7 @@ void Editbox::handle_keypress(SDL_Keycode key) {
             return;
         }
         std::string s = lines.extract_selection();
-        LOG_DEBUG("Copying '%s' to clipboard", s.c_str());
+        LOG_DEBUG_CAT(LogCategory::EDITOR, "Copying '%s' to clipboard", s.c_str());
         SDL_SetClipboardText(s.c_str());
         if (key == 'x') {
             lines.insert_str("");
@@ -306,9 +439,11 @@ void Editbox::handle_keypress(SDL_Keycode key) {
         reset_cursor_animation();
         lines.insert_str("\n");
     }
+    scroll_to_cursor();
 }
 
 void Editbox::render() const {
+    dirty = false;
     SDL_SetRenderDrawColor(gRenderer, UI_BORDER_COLOR);
     SDL_Rect rect = {x, y, BOX_SIZE, BOX_SIZE};
     SDL_RenderFillRect(gRenderer, &rect);
@@ -318,34 +453,32 @@ void Editbox::render() const {
 
     if (lines.has_selection()) {
         SDL_SetRenderDrawColor(gRenderer, 0x50, 0x50, 0x50, 0xff);
-        int start = lines.get_selection_start().col;
-        for (int row = lines.get_selection_start().row;
-             row < lines.get_selection_end().row; ++row) {
-            int size = lines.line_size(row);
-            SDL_Rect r = {x + BOX_TEXT_MARGIN + BOX_CHAR_WIDTH * start,
-                          y + BOX_LINE_HEIGHT * row + BOX_TEXT_MARGIN,
-                          BOX_CHAR_WIDTH * (size + 1 - start), BOX_LINE_HEIGHT};
+        const TextPosition &start = lines.get_selection_start();
+        const TextPosition &end = lines.get_selection_end();
+        int64_t last_row = std::min<int64_t>(end.row, first_row + BOX_VISIBLE_ROWS - 1);
+        for (int64_t row = std::max(start.row, first_row); row <= last_row; ++row) {
+            int64_t from = row == start.row ? start.col : 0;
+            int64_t to = row == end.row ? end.col : lines.line_size(row) + 1;
+            SDL_Rect r = {static_cast<int>(x + BOX_TEXT_MARGIN + BOX_CHAR_WIDTH * from),
+                          static_cast<int>(y + BOX_LINE_HEIGHT * (row - first_row) +
+                                           BOX_TEXT_MARGIN),
+                          static_cast<int>(BOX_CHAR_WIDTH * (to - from)), BOX_LINE_HEIGHT};
             SDL_RenderFillRect(gRenderer, &r);
-            start = 0;
         }
-        int col = lines.get_selection_end().col;
-        SDL_Rect r = {x + BOX_TEXT_MARGIN + BOX_CHAR_WIDTH * start,
-                      static_cast<int>(
-                          y + BOX_LINE_HEIGHT * lines.get_selection_end().row +
-                          BOX_TEXT_MARGIN),
-                      BOX_CHAR_WIDTH * (col - start), BOX_LINE_HEIGHT};
-        SDL_RenderFillRect(gRenderer, &r);
     }
 
+    gTextPass.begin();
     for (auto &box : boxes) {
         box.render(x + BOX_TEXT_MARGIN, y + BOX_TEXT_MARGIN, *window_state);
     }
     for (auto &box : error_msg) {
         box.render(x, y, *window_state);
     }
+    gTextPass.end();
 
-    if (show_cursor) {
-        TextPosition cursor_pos = lines.get_cursor_pos();
+    TextPosition cursor_pos = lines.get_cursor_pos();
+    cursor_pos.row -= first_row;
+    if (show_cursor && cursor_pos.row >= 0 && cursor_pos.row < BOX_VISIBLE_ROWS) {
         SDL_SetRenderDrawColor(gRenderer, 0xf0, 0xf0, 0xf0, 0xff);
         if (!insert_mode) {
             SDL_RenderDrawLine(
@@ -365,6 +498,7 @@ void Editbox::render() const {
     }
 }
 void Editbox::set_dpi_scale(double dpi) {
+    dirty = true;
     for (auto &line : boxes) {
         line.set_dpi_ratio(dpi);
     }
@@ -378,28 +512,26 @@ bool Editbox::is_pressed(int mouse_x, int mouse_y) const {
 }
 void Editbox::change_callback(TextPosition start, TextPosition end,
                               int64_t removed) {
+    dirty = true;
+    ++edit_count;
     max_col = lines.get_cursor_pos().col;
-    if (boxes.size() == lines.line_count()) {
-        for (int i = start.row; i <= end.row; ++i) {
-            boxes[i].set_text(lines.get_lines()[i]);
-        }
-        return;
+    // Rows [start.row, end.row] replaced the rows from start.row up to the
+    // old end, keep the cached colors of all other rows.
+    int64_t added = lines.line_count() - shown_lines;
+    if (added > 0) {
+        row_colors.insert(row_colors.begin() + start.row + 1, added, {});
+    } else if (added < 0) {
+        row_colors.erase(row_colors.begin() + start.row + 1,
+                         row_colors.begin() + start.row + 1 - added);
     }
-    if (boxes.size() < lines.line_count()) {
-        for (int i = boxes.size(); i < lines.line_count(); ++i) {
-            boxes.emplace_back(0, 0 + BOX_LINE_HEIGHT * i,
-                               BOX_SIZE - 2 * BOX_TEXT_MARGIN, BOX_LINE_HEIGHT,
-                               "", *window_state);
-            boxes.back().set_align(Alignment::LEFT);
-        }
-    } else if (boxes.size() > lines.line_count()) {
-        boxes.resize(lines.line_count());
-    }
-    for (int64_t i = start.row; i < lines.line_count(); ++i) {
-        if (lines.get_lines()[i] != boxes[i].get_text()) {
-            boxes[i].set_text(lines.get_lines()[i]);
-        }
+    lex_rows(start.row, end.row);
+    if (lines.line_count() != shown_lines) {
+        // All following rows moved.
+        shown_lines = lines.line_count();
+        end.row = INT64_MAX - 1;
     }
+    refresh_rows(start.row, end.row);
+    scroll_to_cursor();
 }
 
 void change_callback(TextPosition start, TextPosition end, int64_t removed,
@@ -23,6 +23,17 @@ public:
 
     void render() const;
 
+    /**
+     * Returns true if the box changed since it was last rendered.
+     */
+    [[nodiscard]] bool is_dirty() const { return dirty; }
+
+    /**
+     * Returns the milliseconds until the cursor blinks, or -1 if the box is
+     * not selected.
+     */
+    [[nodiscard]] int idle_timeout() const;
+
     void set_dpi_scale(double dpi);
 
     void tick(Uint64 passed);
@@ -37,11 +48,31 @@ public:
 
     const std::vector<std::string>& get_text() const;
 
+    /**
+     * Returns a number that changes whenever the text changes.
+     */
+    [[nodiscard]] uint64_t get_edit_count() const { return edit_count; }
+
     void input_char(char c);
 
     void set_text(std::string& text);
 
     void set_errors(std::vector<ErrorMsg> msgs);
+
+    /**
+     * Sets what the text is highlighted as, and highlights all rows again.
+     */
+    void set_syntax(SyntaxTable table);
+
+    /**
+     * Scrolls the view by rows, clamped to the text.
+     */
+    void scroll(int64_t rows);
+
+    /**
+     * Returns the first visible row.
+     */
+    [[nodiscard]] int64_t get_first_row() const { return first_row; }
 private:
     friend void change_callback(TextPosition, TextPosition, int64_t, void*);
     void change_callback(TextPosition start, TextPosition end, int64_t removed);
@@ -50,6 +81,21 @@ private:
 
     void reset_cursor_animation();
 
+    // Scrolls just enough to make the cursor visible.
+    void scroll_to_cursor();
+
+    void set_first_row(int64_t row);
+
+    // Updates the boxes of visible rows in [start, end]. Unless force is
+    // set, only boxes with changed text are updated.
+    void refresh_rows(int64_t start, int64_t end, bool force = false);
+
+    // Highlights rows in [start, end] into row_colors.
+    void lex_rows(int64_t start, int64_t end);
+
+    // Updates error_msg for the errors on visible rows.
+    void refresh_errors();
+
     int x{}, y{};
 
     int64_t max_col {0};
@@ -59,12 +105,27 @@ private:
 
     EditLines lines {MAX_LINES, MAX_LINE_WIDTH, ::change_callback, this};
 
+    // One box per visible row, boxes[i] shows row first_row + i.
     std::vector<TextBox> boxes {};
     std::vector<TextBox> error_msg {};
+    std::vector<ErrorMsg> errors {};
+
+    SyntaxTable syntax {};
+    // Color of each character of each row, empty for rows without tokens.
+    std::vector<std::vector<SDL_Color>> row_colors = std::vector<std::vector<SDL_Color>>(1);
+    std::vector<Token> tokens {};
+
+    uint64_t edit_count {0};
+
+    int64_t first_row {0};
+    // Line count the boxes were last refreshed for.
+    int64_t shown_lines {1};
 
     bool show_cursor {false};
     Sint64 ticks_remaining = 0;
 
+    mutable bool dirty {true};
+
     const WindowState* window_state {nullptr};
 };
 
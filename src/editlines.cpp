@@ -1,7 +1,7 @@
 #include "editlines.h"
-#include <sstream>
 #include <climits>
 #include <algorithm>
+#include <iterator>
 #include "config.h"
 
 bool TextPosition::operator<(const TextPosition &other) const {
@@ -27,37 +27,69 @@ bool TextPosition::operator!=(const TextPosition &other) const {
 }
 
 unsigned EditStack::size() const {
-    return data_size;
+    return static_cast<unsigned>(entries.size());
 }
 
 void EditStack::clear() {
-    data_size = 0;
-    pos = 0;
+    entries.clear();
+    buffer.clear();
+    base = 0;
 }
 
 void EditStack::push(const EditAction &action) {
-    if (data_size < BOX_UNDO_BUFFER_SIZE) {
-        ++data_size;
-    }
-    if (pos == data.size()) {
-        data.push_back(action);
-    } else {
-        data[pos] = action;
-    }
-    pos = (pos + 1) % BOX_UNDO_BUFFER_SIZE;
+    entries.push_back({action.start, action.end, buffer.size(),
+                       action.text.size(), action.chain});
+    buffer += action.text;
+    trim();
+}
+
+const TextPosition &EditStack::top_end() const {
+    return entries.back().end;
 }
 
-EditAction& EditStack::top() {
-    return data[(pos + BOX_UNDO_BUFFER_SIZE - 1) % BOX_UNDO_BUFFER_SIZE];
+void EditStack::extend_top(TextPosition end, const std::string &text) {
+    // The text of the top entry is always last in buffer.
+    entries.back().end = end;
+    entries.back().size += text.size();
+    buffer += text;
+    trim();
 }
 
 EditAction EditStack::pop() {
-    --data_size;
-    EditAction res = std::move(top());
-    pos = (pos + BOX_UNDO_BUFFER_SIZE - 1) % BOX_UNDO_BUFFER_SIZE;
+    const Entry &entry = entries.back();
+    EditAction res{entry.start, entry.end,
+                   buffer.substr(entry.offset, entry.size), entry.chain};
+    buffer.resize(entry.offset);
+    entries.pop_back();
+    if (entries.empty()) {
+        clear();
+    }
     return res;
 }
 
+std::size_t EditStack::byte_size() const {
+    return buffer.size() - base + entries.size() * sizeof(Entry);
+}
+
+void EditStack::trim() {
+    // Always keep the newest entry, even if it alone is too large.
+    while (entries.size() > 1 && byte_size() > static_cast<std::size_t>(BOX_UNDO_BUFFER_BYTES)) {
+        entries.pop_front();
+        base = entries.front().offset;
+        // The oldest entry can not chain to a dropped one, the rest of
+        // its chain is undone on its own.
+        entries.front().chain = false;
+    }
+    if (base > buffer.size() / 2) {
+        // Move the live text to the front once half the buffer is dropped.
+        buffer.erase(0, base);
+        for (auto &entry : entries) {
+            entry.offset -= base;
+        }
+        base = 0;
+    }
+}
+
 EditLines::EditLines(int64_t max_rows, int64_t max_cols, void (*change_callback)(TextPosition start, TextPosition end, int64_t removed, void*), void* aux) : lines(1, ""),
                                                    max_rows{static_cast<std::size_t>(max_rows == -1 ? INT64_MAX : max_rows)},
                                                    max_cols{static_cast<std::size_t>(max_cols == -1 ? INT64_MAX : max_cols)},
@@ -72,16 +104,14 @@ void EditLines::delete_region(TextPosition start, TextPosition end) {
     if (start >= end) {
         return;
     }
-    std::string first = lines[start.row];
-    first.erase(start.col);
-    std::string last = lines[end.row];
-    last.erase(0, end.col);
-    lines[start.row] = first + last;
-    for (int64_t ix = 0; ix < lines.size() - (end.row + 1); ++ix) {
-        lines[start.row + ix + 1] = lines[end.row + 1 + ix];
+    if (start.row == end.row) {
+        lines[start.row].erase(start.col, end.col - start.col);
+        return;
     }
-    int64_t rem_lines = static_cast<int64_t>(lines.size()) - (end.row - start.row);
-    lines.resize(rem_lines);
+    std::string &first = lines[start.row];
+    first.erase(start.col);
+    first.append(lines[end.row], end.col, std::string::npos);
+    lines.erase(lines.begin() + start.row + 1, lines.begin() + end.row + 1);
 }
 
 bool EditLines::insert_region(const std::string &str, TextPosition start, TextPosition end, EditAction &action) {
@@ -110,30 +140,26 @@ bool EditLines::insert_region(const std::string &str, TextPosition start, TextPo
             delete_region(start, end);
         }
         TextPosition start_pos = start;
-        std::string s = lines[start.row];
-        s.insert(start.col, str);
-        lines[start.row] = s;
+        lines[start.row].insert(start.col, str);
         start.col += static_cast<int64_t>(str.size());
         if (split_delete) {
             action = {start_pos, {start.row + 1, 0}, old};
         } else {
-            action = {start_pos, start, old};
+            action = {start_pos, start, std::move(old)};
         }
     } else {
         size_t ix = str.find('\n');
-        std::string first = str.substr(0, ix);
-        if (start.col + first.size() > max_cols) {
+        if (start.col + ix > max_cols) {
             return false;
         }
         size_t last_ix = str.rfind('\n');
-        std::string last = str.substr(last_ix + 1);
-        if (line_size(end.row) - end.col + last.size() > max_cols) {
+        size_t last_size = str.size() - (last_ix + 1);
+        if (line_size(end.row) - end.col + last_size > max_cols) {
             return false;
         }
-        std::string rem = str.substr(ix + 1, last_ix - ix);
-        size_t offset = 0;
+        size_t offset = ix + 1;
         for (int64_t i = 0; i < new_rows - 1; ++i) {
-            size_t pos = rem.find('\n', offset);
+            size_t pos = str.find('\n', offset);
             if (pos - offset > max_cols) {
                 return false;
             }
@@ -141,24 +167,29 @@ bool EditLines::insert_region(const std::string &str, TextPosition start, TextPo
         }
         std::string old = extract_region(start, end);
         delete_region(start, end);
-        std::string s = lines[start.row];
-        std::string end_str = s.substr(start.col);
-        s.erase(start.col);
-        lines[start.row] = (s + first);
-        offset = 0;
-        for (int64_t i = 1; i <= new_rows; ++i) {
-            lines.insert(lines.begin() + start.row + i, "");
-        }
+
+        // Build the new rows first, so the following rows are only moved once.
+        std::vector<std::string> new_lines{};
+        new_lines.reserve(new_rows);
+        offset = ix + 1;
         for (int64_t i = 1; i < new_rows; ++i) {
-            size_t pos = rem.find('\n', offset);
-            lines[start.row + i] = (rem.substr(offset, pos - offset));
+            size_t pos = str.find('\n', offset);
+            new_lines.emplace_back(str, offset, pos - offset);
             offset = pos + 1;
         }
+        std::string &line = lines[start.row];
+        new_lines.emplace_back(str, last_ix + 1);
+        new_lines.back().append(line, start.col, std::string::npos);
+        line.erase(start.col);
+        line.append(str, 0, ix);
+        lines.insert(lines.begin() + start.row + 1,
+                     std::make_move_iterator(new_lines.begin()),
+                     std::make_move_iterator(new_lines.end()));
+
         TextPosition start_pos = start;
-        lines[start.row + new_rows] = (last + end_str);
         start.row += new_rows;
-        start.col = static_cast<int64_t>(last.size());
-        action = {start_pos, start, old};
+        start.col = static_cast<int64_t>(last_size);
+        action = {start_pos, start, std::move(old)};
     }
     return true;
 }
@@ -290,9 +321,8 @@ bool EditLines::insert_str(const std::string &str, EditType edit) {
         if (undo_stack.size() == 0) {
             undo_stack.push(action);
         } else {
-            if (undo_stack.top().end == action.start) {
-                undo_stack.top().end = action.end;
-                undo_stack.top().text += action.text;
+            if (undo_stack.top_end() == action.start) {
+                undo_stack.extend_top(action.end, action.text);
             } else {
                 undo_stack.push(action);
             }
@@ -306,6 +336,40 @@ bool EditLines::insert_str(const std::string &str, EditType edit) {
 }
 
 
+bool EditLines::set_text(const std::string &str) {
+    std::vector<std::string> new_lines{};
+    new_lines.reserve(std::count(str.begin(), str.end(), '\n') + 1);
+    std::size_t offset = 0;
+    while (true) {
+        std::size_t pos = str.find('\n', offset);
+        std::size_t end = pos == std::string::npos ? str.size() : pos;
+        if (end - offset > max_cols) {
+            return false;
+        }
+        new_lines.emplace_back(str, offset, end - offset);
+        if (pos == std::string::npos) {
+            break;
+        }
+        offset = pos + 1;
+    }
+    if (new_lines.size() > max_rows) {
+        return false;
+    }
+    int64_t removed = static_cast<int64_t>(lines.size()) - 1;
+    for (const auto &line : lines) {
+        removed += static_cast<int64_t>(line.size());
+    }
+    lines = std::move(new_lines);
+    cursor_pos = {line_count() - 1, line_size(line_count() - 1)};
+    clear_selection();
+    clear_undo_stack();
+    clear_action();
+    if (change_callback != nullptr) {
+        change_callback({0, 0}, cursor_pos, removed, aux_data);
+    }
+    return true;
+}
+
 std::string EditLines::extract_region(TextPosition start,
                                       TextPosition end) const {
     if (start == end) {
@@ -315,13 +379,20 @@ std::string EditLines::extract_region(TextPosition start,
         return lines[start.row].substr(start.col,
                                                   end.col - start.col);
     } else {
-        std::stringstream res{};
-        res << lines[start.row].substr(start.col);
+        std::size_t size = lines[start.row].size() - start.col + end.col;
+        for (int64_t row = start.row + 1; row <= end.row; ++row) {
+            size += 1 + (row < end.row ? lines[row].size() : 0);
+        }
+        std::string res{};
+        res.reserve(size);
+        res.append(lines[start.row], start.col, std::string::npos);
         for (int64_t row = start.row + 1; row < end.row; ++row) {
-            res << '\n' << lines[row];
+            res += '\n';
+            res += lines[row];
         }
-        res << '\n' << lines[end.row].substr(0, end.col);
-        return res.str();
+        res += '\n';
+        res.append(lines[end.row], 0, end.col);
+        return res;
     }
 }
 std::string EditLines::extract_selection() const {
@@ -344,7 +415,7 @@ void EditLines::undo_action(bool redo) {
         selection_end = action.end;
         cursor_pos = selection_start;
         insert_str(action.text, edit);
-    } while (action.chain);
+    } while (action.chain && stack.size() != 0);
     edit_action = EditType::NONE;
 }
 
@@ -421,6 +492,22 @@ int main() {
     ASSERT_EQ(lines.get_selection_end(), lines.get_cursor_pos())
     ASSERT_EQ(lines.has_selection(), false)
 
+    {
+        // A chain longer than the undo budget loses its oldest entries.
+        EditLines deep{-1, -1, nullptr, nullptr};
+        for (int i = 0; i < 30000; ++i) {
+            deep.set_cursor({0, 0}, false);
+            deep.insert_str("x", EditType::WRITE);
+        }
+        deep.undo_action(false);
+        std::size_t left = deep.get_lines()[0].size();
+        ASSERT_EQ(left > 0 && left < 30000, true)
+        deep.undo_action(false);
+        ASSERT_EQ(deep.get_lines()[0].size(), left)
+        deep.undo_action(true);
+        ASSERT_EQ(deep.get_lines()[0].size() > left, true)
+    }
+
 end:
 std::cout << passed_tests << " / " << test_ix << " tests passed" << std::endl;
 }
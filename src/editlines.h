@@ -2,6 +2,7 @@
 #define PROCASM_EDITLINES_H
 #include <string>
 #include <vector>
+#include <deque>
 #include <cstdint>
 
 /**
@@ -35,7 +36,10 @@ struct EditAction {
 };
 
 /**
- * A finite size stack of actions.
+ * A stack of actions bounded by memory use rather than entry count.
+ * Deleted text of all actions is stored back to back in one buffer, each
+ * action only keeps its position in it. When the stack grows past its byte
+ * budget the oldest actions are dropped.
  **/
 class EditStack {
 public:
@@ -50,18 +54,27 @@ public:
     void clear();
 
     /**
-     * Push an action to the stack, potentialy removing the oldest one. 
+     * Push an action to the stack, potentialy removing the oldest ones.
      *
      * @param action: the action to add 
      **/
     void push(const EditAction& action);
 
     /**
-     * Peek at the top of the stack. Undefined behaviour if stack is empty.
+     * Peek at the end of the top action. Undefined behaviour if stack is empty.
      *
-     * @return the top element of the stack.
+     * @return the end position of the top element of the stack.
      **/
-    EditAction& top();
+    const TextPosition& top_end() const;
+
+    /**
+     * Merges a following action into the top action, moving its end and
+     * appending the deleted text. Undefined behaviour if stack is empty.
+     *
+     * @param end the new end position.
+     * @param text the text to append.
+     **/
+    void extend_top(TextPosition end, const std::string& text);
 
     /**
      * Pop the top element of the stack. Undefined behaviour if stack is empty.
@@ -69,9 +82,28 @@ public:
      * @return the previous top element of the stack.
      */
     EditAction pop();
+
+    /**
+     * Returns the number of bytes currently used by the stack.
+     **/
+    std::size_t byte_size() const;
 private:
-    unsigned pos {0}, data_size {0};
-    std::vector<EditAction> data {};
+    struct Entry {
+        TextPosition start;
+        TextPosition end;
+        // Range of the deleted text in buffer.
+        std::size_t offset;
+        std::size_t size;
+        bool chain;
+    };
+
+    // Drops the oldest entries until the stack fits its byte budget.
+    void trim();
+
+    std::deque<Entry> entries {};
+    std::string buffer {};
+    // Start of the text of the oldest entry in buffer.
+    std::size_t base {0};
 };
 
 /**
@@ -162,6 +194,16 @@ public:
      **/
     bool insert_str(const std::string& str, EditType type = EditType::NONE);
 
+    /**
+     * Replaces all text at once, without going through the undo stack.
+     * Clears both stacks and places the cursor at the end.
+     * Does nothing if the text does not fit.
+     *
+     * @param str the new text.
+     * @return true if the text was replaced.
+     **/
+    bool set_text(const std::string& str);
+
     /**
      * Gets the current cursor position. Will be the same as at least one of
      * get_selection_start and get_selection_end.
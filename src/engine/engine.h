@@ -18,6 +18,13 @@ struct SurfaceDeleter {
     void operator()(SDL_Surface *s) { SDL_FreeSurface(s); }
 };
 
+/**
+ * Struct used for putting an SDL_Texture in a smart-pointer.
+ */
+struct TextureDeleter {
+    void operator()(SDL_Texture *t) { SDL_DestroyTexture(t); }
+};
+
 namespace engine {
     void init();
 
@@ -25,8 +32,17 @@ namespace engine {
 
     /**
     * Returns a random number between min (inclusive) and max (exclusive).
+    * Every thread has its own generator, see seed_random.
     */
     int random(int min, int max);
+
+    /**
+    * Seeds random for the calling thread, with stream split from seed.
+    * The values only depend on seed and stream, so a worker that seeds
+    * with the index of its test case generates the same data whichever
+    * thread runs it. Threads that never call this use seed 0, stream 0.
+    */
+    void seed_random(uint64_t seed, uint64_t stream);
 }; // namespace engine
 
 #endif
@@ -1,7 +1,23 @@
 #include "events.h"
 #include "exceptions.h"
 #include "log.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+int ctz64(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long ix;
+    _BitScanForward64(&ix, x);
+    return static_cast<int>(ix);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
 
+}
 
 template <> uint64_t EventInfo::get() { return u; }
 
@@ -99,6 +115,17 @@ Events::Events() noexcept : events{{EventType::EMPTY}}, scopes{} {
     root_scope->finalize();
 }
 
+Events::~Events() {
+    root_scope.reset();
+    // Closures of scopes that outlived the event system.
+    for (std::size_t ix = 0; ix < aux_count; ++ix) {
+        AuxSlot &slot = aux_chunks[ix / AUX_CHUNK_SIZE][ix % AUX_CHUNK_SIZE];
+        if (slot.destroy != nullptr) {
+            slot.destroy(&slot);
+        }
+    }
+}
+
 std::unique_ptr<EventScope> Events::begin_scope() {
     auto ptr = std::make_unique<EventScope>(this);
     scopes.emplace_back(ptr.get());
@@ -108,13 +135,13 @@ std::unique_ptr<EventScope> Events::begin_scope() {
 void Events::end_scope(EventScope *ptr) {
     for (int64_t i = scopes.size() - 1; i >= 0; --i) {
         if (scopes[i] == ptr) {
-            LOG_WARNING("End scope called");
+            LOG_WARNING_CAT(LogCategory::ENGINE, "End scope called");
 
             scopes.erase(scopes.begin() + i);
             return;
         }
     }
-    LOG_WARNING("Invalid scope end");
+    LOG_WARNING_CAT(LogCategory::ENGINE, "Invalid scope end");
 }
 
 void Events::finalize_scope() {
@@ -128,7 +155,7 @@ void Events::finalize_scope() {
 
 event_t Events::register_event(EventType type, int vector_size) {
     event_t id = free_ix;
-    LOG_DEBUG("Event %u registered", id);
+    LOG_DEBUG_CAT(LogCategory::ENGINE, "Event %u registered", id);
     ++free_ix;
     for (; free_ix < events.size(); ++free_ix) {
         if (events[free_ix].type == EventType::EMPTY) {
@@ -146,10 +173,7 @@ event_t Events::register_event(EventType type, int vector_size) {
         if (vector_size <= 1) {
             events[id].type = EventType::UNIFIED;
         } else {
-            events[id].buffer.resize(vector_size);
-            for (auto &e : events[id].buffer) {
-                e.u = 0;
-            }
+            events[id].bits.resize((vector_size + 63) / 64, 0);
         }
     }
     scopes.back()->add_event(id);
@@ -159,7 +183,8 @@ event_t Events::register_event(EventType type, int vector_size) {
 void Events::register_callback(event_t id, void (*callback)(EventInfo, void *),
                                void *aux) {
     scopes.back()->add_callback(id, events[id].free_ix);
-    LOG_DEBUG("Event %d callback added at %d", id, events[id].free_ix);
+    LOG_DEBUG_CAT(LogCategory::ENGINE, "Event %d callback added at %llu", id,
+                  static_cast<unsigned long long>(events[id].free_ix));
     if (events[id].free_ix == events[id].callbacks.size()) {
         events[id].callbacks.push_back({callback, aux});
         events[id].last_ix = events[id].free_ix;
@@ -179,56 +204,64 @@ void Events::register_callback(event_t id, void (*callback)(EventInfo, void *),
     }
 }
 
+void Events::queue_event(event_t id) {
+    if (!events[id].queued) {
+        events[id].queued = true;
+        dirty.push_back(id);
+    }
+}
+
 void Events::notify_event(event_t id, EventInfo data) {
     switch (events[id].type) {
     case EventType::IMMEDIATE:
-        for (auto &cb : events[id].callbacks) {
-            cb.callback(data, cb.aux);
-        }
+        call_callbacks(id, data);
         return;
     case EventType::DELAYED:
         events[id].buffer.push_back(data);
+        queue_event(id);
         return;
     case EventType::UNIFIED:
         events[id].data = data;
         events[id].triggered = true;
+        queue_event(id);
         return;
     case EventType::UNIFIED_VEC:
-        events[id].buffer[data.u].u = 1;
+        events[id].bits[data.u / 64] |= uint64_t{1} << (data.u % 64);
         events[id].triggered = true;
+        queue_event(id);
         return;
     case EventType::EMPTY:
-        LOG_WARNING("Empty event %d called", id);
+        LOG_WARNING_CAT(LogCategory::ENGINE, "Empty event %d called", id);
         return;
     }
 }
 
-void Events::add_aux(WrapperBase *aux) {
-    scopes.back()->add_aux(free_aux);
-    if (free_aux == aux_data.size()) {
-        aux_data.emplace_back(aux);
-        ++free_aux;
+Events::AuxSlot &Events::alloc_aux() {
+    std::size_t ix;
+    if (!free_aux.empty()) {
+        ix = free_aux.back();
+        free_aux.pop_back();
     } else {
-        aux_data[free_aux].reset(aux);
-        ++free_aux;
-        for (; free_aux < aux_data.size(); ++free_aux) {
-            if (aux_data[free_aux] == nullptr) {
-                break;
-            }
+        ix = aux_count++;
+        if (ix / AUX_CHUNK_SIZE == aux_chunks.size()) {
+            aux_chunks.emplace_back(new AuxSlot[AUX_CHUNK_SIZE]);
         }
     }
+    scopes.back()->add_aux(ix);
+    return aux_chunks[ix / AUX_CHUNK_SIZE][ix % AUX_CHUNK_SIZE];
 }
 
 void null_callback(EventInfo, void*) {}
 
 void Events::remove_event(event_t event) {
-    LOG_DEBUG("Removing event %d", event);
+    LOG_DEBUG_CAT(LogCategory::ENGINE, "Removing event %d", event);
     if (event <= 0 || event >= events.size()) {
-        LOG_WARNING("Out of bounds event removed");
+        LOG_WARNING_CAT(LogCategory::ENGINE, "Out of bounds event removed");
         return;
     }
     events[event].type = EventType::EMPTY;
     events[event].buffer.clear();
+    events[event].bits.clear();
     events[event].callbacks.clear();
     if (event < free_ix) {
         free_ix = event;
@@ -246,17 +279,18 @@ void Events::remove_event(event_t event) {
 }
 
 void Events::remove_callback(event_t event, std::size_t ix) {
-    LOG_DEBUG("Removing event %d callback %d", event, ix);
+    LOG_DEBUG_CAT(LogCategory::ENGINE, "Removing event %d callback %llu", event,
+                  static_cast<unsigned long long>(ix));
     if (event <= 0 || event >= events.size()) {
-        LOG_WARNING("Out of bounds event callback removed");
+        LOG_WARNING_CAT(LogCategory::ENGINE, "Out of bounds event callback removed");
         return;
     }
     if (events[event].callbacks.size() <= ix) {
-        LOG_WARNING("Out of bounds event callback removed");
+        LOG_WARNING_CAT(LogCategory::ENGINE, "Out of bounds event callback removed");
         return;
     }
     if (events[event].type == EventType::EMPTY) {
-        LOG_WARNING("Removing callback from empty event");
+        LOG_WARNING_CAT(LogCategory::ENGINE, "Removing callback from empty event");
         return;
     }
     events[event].callbacks[ix].callback = null_callback;
@@ -277,39 +311,52 @@ void Events::remove_callback(event_t event, std::size_t ix) {
 }
 
 void Events::remove_aux(std::size_t ix) {
-    LOG_DEBUG("Removing aux %d", ix);
-    aux_data[ix].reset();
-    if (ix < free_aux) {
-        free_aux = ix;
+    LOG_DEBUG_CAT(LogCategory::ENGINE, "Removing aux %llu",
+                  static_cast<unsigned long long>(ix));
+    AuxSlot &slot = aux_chunks[ix / AUX_CHUNK_SIZE][ix % AUX_CHUNK_SIZE];
+    slot.destroy(&slot);
+    slot.destroy = nullptr;
+    free_aux.push_back(ix);
+}
+
+void Events::call_callbacks(event_t id, EventInfo data) {
+    // Callbacks may register new events and callbacks, reallocating both.
+    for (std::size_t i = 0; id < events.size() && i < events[id].callbacks.size(); ++i) {
+        auto cb = events[id].callbacks[i];
+        cb.callback(data, cb.aux);
     }
 }
 
 void Events::handle_events() {
-    for (auto event = events.begin() + 1; event != events.end(); ++event) {
-        if (event->type == EventType::UNIFIED && event->triggered) {
-            for (auto &cb : event->callbacks) {
-                cb.callback(event->data, cb.aux);
-            }
-            event->triggered = false;
-        } else if (event->type == EventType::DELAYED) {
-            for (EventInfo data : event->buffer) {
-                for (auto &cb : event->callbacks) {
-                    cb.callback(data, cb.aux);
-                }
+    handling.swap(dirty);
+    for (event_t id : handling) {
+        if (id >= events.size()) {
+            continue;
+        }
+        EventData &event = events[id];
+        event.queued = false;
+        if (event.type == EventType::UNIFIED && event.triggered) {
+            event.triggered = false;
+            call_callbacks(id, event.data);
+        } else if (event.type == EventType::DELAYED) {
+            handling_buffer.swap(event.buffer);
+            for (EventInfo data : handling_buffer) {
+                call_callbacks(id, data);
             }
-            event->buffer.clear();
-        } else if (event->type == EventType::UNIFIED_VEC && event->triggered) {
-            for (uint64_t i = 0; i < event->buffer.size(); ++i) {
-                if (event->buffer[i].u != 0) {
-                    event->buffer[i].u = 0;
+            handling_buffer.clear();
+        } else if (event.type == EventType::UNIFIED_VEC && event.triggered) {
+            event.triggered = false;
+            for (std::size_t w = 0; id < events.size() && w < events[id].bits.size(); ++w) {
+                uint64_t word = events[id].bits[w];
+                events[id].bits[w] = 0;
+                while (word != 0) {
                     EventInfo data {};
-                    data.u = i;
-                    for (auto &cb : event->callbacks) {
-                        cb.callback(data, cb.aux);
-                    }
+                    data.u = w * 64 + ctz64(word);
+                    word &= word - 1;
+                    call_callbacks(id, data);
                 }
             }
-            event->triggered = false;
         }
     }
+    handling.clear();
 }
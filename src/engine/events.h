@@ -1,7 +1,9 @@
 #ifndef ENGINE_ENVENT_H
 #define ENGINE_ENVENT_H
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <new>
 #include <tuple>
 #include <vector>
 #include <forward_list>
@@ -118,14 +120,13 @@ public:
 
     template <class T, class... Args>
     void register_callback(event_t id, void (*callback)(T, Args...), Args... args) {
-        struct Wrapper : public WrapperBase {
+        struct Wrapper {
             explicit Wrapper(Args... args, void (*cb)(T, Args...))
                 : args{args...}, cb{cb} {}
             std::tuple<Args...> args;
             void (*cb)(T, Args...);
         };
-        auto* aux = new Wrapper{args..., callback};
-        add_aux(aux);
+        auto* aux = emplace_aux<Wrapper>(args..., callback);
         auto call = [](EventInfo i, void *aux) {
             Wrapper &w = *reinterpret_cast<Wrapper *>(aux);
             w.cb(i.get<T>(), std::get<Args>(w.args)...);
@@ -135,14 +136,13 @@ public:
 
     template <class... Args>
     void register_callback(event_t id, void (*callback)(Args...), Args... args) {
-        struct Wrapper : public WrapperBase {
+        struct Wrapper {
             explicit Wrapper(Args... args, void (*cb)(Args...))
                 : args{args...}, cb{cb} {}
             std::tuple<Args...> args;
             void (*cb)(Args...);
         };
-        auto* aux = new Wrapper{args..., callback};
-        add_aux(aux);
+        auto* aux = emplace_aux<Wrapper>(args..., callback);
         auto call = [](EventInfo i, void *aux) {
             Wrapper &w = *reinterpret_cast<Wrapper *>(aux);
             w.cb(std::get<Args>(w.args)...);
@@ -159,14 +159,47 @@ public:
 
     void notify_event(event_t id, EventInfo data);
 
+    /**
+     * Runs the callbacks of all delayed events fired since the last call.
+     * Events fired by these callbacks are handled by the next call.
+     */
     void handle_events();
 
+    ~Events();
+
 private:
-    struct WrapperBase {
-        virtual ~WrapperBase() = default;
+    /**
+     * Storage for the closure of one callback. Closures that fit are
+     * constructed in place, larger ones are heap allocated.
+     */
+    struct AuxSlot {
+        static constexpr std::size_t SIZE = 48;
+        alignas(std::max_align_t) unsigned char storage[SIZE];
+        void (*destroy)(AuxSlot *) = nullptr;
     };
+    // Slots are allocated in chunks, so closures never move.
+    static constexpr std::size_t AUX_CHUNK_SIZE = 64;
+
+    template <class W, class... Args> W *emplace_aux(Args... args) {
+        AuxSlot &slot = alloc_aux();
+        if constexpr (sizeof(W) <= AuxSlot::SIZE &&
+                      alignof(W) <= alignof(std::max_align_t)) {
+            W *w = new (slot.storage) W{args...};
+            slot.destroy = [](AuxSlot *s) {
+                std::launder(reinterpret_cast<W *>(s->storage))->~W();
+            };
+            return w;
+        } else {
+            W *w = new W{args...};
+            new (slot.storage) W *(w);
+            slot.destroy = [](AuxSlot *s) {
+                delete *std::launder(reinterpret_cast<W **>(s->storage));
+            };
+            return w;
+        }
+    }
 
-    void add_aux(WrapperBase* ptr);
+    AuxSlot &alloc_aux();
 
     void remove_callback(event_t event, std::size_t ix);
 
@@ -176,8 +209,9 @@ private:
 
     void end_scope(EventScope* ptr);
 
-    std::vector<std::unique_ptr<WrapperBase>> aux_data{};
-    std::size_t free_aux = 0;
+    std::vector<std::unique_ptr<AuxSlot[]>> aux_chunks{};
+    std::vector<std::size_t> free_aux{};
+    std::size_t aux_count = 0;
 
     struct CallbackData {
         void (*callback)(EventInfo, void *);
@@ -187,16 +221,30 @@ private:
         EventType type;
         EventInfo data;
         bool triggered;
+        // Set while the event is in dirty.
+        bool queued;
         std::vector<EventInfo> buffer{};
+        // One bit per index of an UNIFIED_VEC event.
+        std::vector<uint64_t> bits{};
         std::vector<CallbackData> callbacks{};
         std::size_t free_ix = 0;
         int64_t last_ix = -1;
     };
 
+    void queue_event(event_t id);
+
+    void call_callbacks(event_t id, EventInfo data);
+
     std::vector<EventData> events {};
     std::size_t free_ix = 1;
     int64_t last_ix = 0;
 
+    // Events fired since the last handle_events, each at most once.
+    std::vector<event_t> dirty {};
+    // Events being handled, kept to reuse its memory.
+    std::vector<event_t> handling {};
+    std::vector<EventInfo> handling_buffer {};
+
     std::vector<EventScope*> scopes {};
 
     std::unique_ptr<EventScope> root_scope{};
@@ -2,6 +2,7 @@
 #include "style.h"
 #include "log.h"
 #include "engine.h"
+#include "glyph_atlas.h"
 #include <utility>
 
 SDL_Renderer *gRenderer;
@@ -56,6 +57,52 @@ void Game::create() {
     init();
 }
 
+void wake_game_loop() {
+    SDL_Event e{};
+    e.type = SDL_USEREVENT;
+    SDL_PushEvent(&e);
+}
+
+void Game::handle_event(SDL_Event &e) {
+    redraw = true;
+    switch (e.type) {
+    case SDL_QUIT:
+        exit_game();
+        break;
+    case SDL_KEYDOWN:
+        handle_keydown(e.key);
+        break;
+    case SDL_KEYUP:
+        handle_keyup(e.key);
+        break;
+    case SDL_MOUSEMOTION:
+        window_state.mouseX = e.motion.x;
+        window_state.mouseY = e.motion.y;
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+        handle_mousedown(e.button);
+        break;
+    case SDL_MOUSEBUTTONUP:
+        handle_mouseup(e.button);
+        break;
+    case SDL_MOUSEWHEEL:
+        handle_mousewheel(e.wheel);
+        break;
+    case SDL_TEXTINPUT:
+        handle_textinput(e.text);
+        break;
+    case SDL_WINDOWEVENT:
+        if (e.window.event == SDL_WINDOWEVENT_RESIZED ||
+            e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+            handle_size_change();
+        } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+            handle_focus_change(false);
+        } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+            handle_focus_change(true);
+        }
+    }
+}
+
 void Game::run() {
     if (destroyed) {
         return;
@@ -66,42 +113,7 @@ void Game::run() {
     while (true) {
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
-            switch (e.type) {
-            case SDL_QUIT:
-                exit_game();
-                break;
-            case SDL_KEYDOWN:
-                handle_keydown(e.key);
-                break;
-            case SDL_KEYUP:
-                handle_keyup(e.key);
-                break;
-            case SDL_MOUSEMOTION:
-                window_state.mouseX = e.motion.x;
-                window_state.mouseY = e.motion.y;
-                break;
-            case SDL_MOUSEBUTTONDOWN:
-                handle_mousedown(e.button);
-                break;
-            case SDL_MOUSEBUTTONUP:
-                handle_mouseup(e.button);
-                break;
-            case SDL_MOUSEWHEEL:
-                handle_mousewheel(e.wheel);
-                break;
-            case SDL_TEXTINPUT:
-                handle_textinput(e.text);
-                break;
-            case SDL_WINDOWEVENT:
-                if (e.window.event == SDL_WINDOWEVENT_RESIZED ||
-                    e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
-                    handle_size_change();
-                } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
-                    handle_focus_change(false);
-                } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-                    handle_focus_change(true);
-                }
-            }
+            handle_event(e);
         }
         window_state.mouse_mask = SDL_GetMouseState(nullptr, nullptr);
 
@@ -111,7 +123,13 @@ void Game::run() {
             break;
         last_time = cur_time;
 
-        render();
+        if (!render()) {
+            // Nothing changed, sleep until an event or the next timer.
+            int timeout = idle_timeout();
+            if (timeout != 0 && SDL_WaitEventTimeout(&e, timeout)) {
+                handle_event(e);
+            }
+        }
     }
     shutdown();
 }
@@ -120,6 +138,7 @@ void Game::exit_game() { running = false; }
 
 Game::~Game() {
     if (!destroyed) {
+        gGlyphAtlas.free();
         SDL_DestroyRenderer(gRenderer);
         gRenderer = nullptr;
 
@@ -154,17 +173,27 @@ void StateGame::init() {
     states.top()->init(&window_state);
 }
 
-void StateGame::render() { 
+bool StateGame::render() {
+    if (!redraw && !states.top()->is_dirty()) {
+        return false;
+    }
+    redraw = false;
     SDL_SetRenderDrawColor(gRenderer, UI_BACKGROUND_COLOR);
     SDL_RenderClear(gRenderer);
     states.top()->render();
 
     SDL_RenderPresent(gRenderer);
+    return true;
 }
 
+int StateGame::idle_timeout() const { return states.top()->idle_timeout(); }
+
 void StateGame::tick(Uint64 delta) {
     StateStatus status = {StateStatus::NONE, nullptr};
     states.top()->tick(delta, status);
+    if (status.action != StateStatus::NONE) {
+        redraw = true;
+    }
 
     switch (status.action) {
     case StateStatus::PUSH:
@@ -179,7 +208,7 @@ void StateGame::tick(Uint64 delta) {
         break;
     case StateStatus::POP:
         states.pop();
-        LOG_DEBUG("Popped state");
+        LOG_DEBUG_CAT(LogCategory::ENGINE, "Popped state");
         if (states.empty()) {
             exit_game();
         } else {
@@ -33,6 +33,11 @@ struct WindowState {
     const Uint8 *keyboard_state;
 };
 
+/**
+ * Wakes up a game loop waiting for events. Safe to call from any thread.
+ */
+void wake_game_loop();
+
 /**
  * Bases Game class, to be extended by a more specific game. On it's own is only
  * a white window with a title that can be closed.
@@ -70,9 +75,17 @@ protected:
     /**
      * Called once per frame, after tick_physics has been called.
      * In the future the renderer might be given as a parameter here instead of
-     * being global.
+     * being global. Returns false if nothing was drawn, in which case the
+     * game loop sleeps instead of presenting a frame.
      */
-    virtual void render() {};
+    virtual bool render() { return true; };
+
+    /**
+     * Milliseconds the game can wait for events before tick has to be called
+     * again, or -1 to wait until an event happens. Only used after a frame
+     * where render had nothing to draw.
+     */
+    [[nodiscard]] virtual int idle_timeout() const { return -1; };
 
     /**
      * Initializes a game, called at the end of create. If init trows an
@@ -122,7 +135,12 @@ protected:
 
     virtual void shutdown() {};
 
+    // Set when an event was received since the last render.
+    bool redraw = true;
+
 private:
+    void handle_event(SDL_Event &e);
+
     bool running = false;
     bool destroyed = true;
 
@@ -180,6 +198,19 @@ public:
      */
     virtual void render() {};
 
+    /**
+     * Returns true if the state changed since it was last rendered.
+     * States that do not track changes are rendered every frame.
+     */
+    [[nodiscard]] virtual bool is_dirty() const { return true; };
+
+    /**
+     * Milliseconds until the state has to be ticked again if no events
+     * happen, or -1 if it only changes on events. For example the time until
+     * a cursor blinks. Only asked when the state is not dirty.
+     */
+    [[nodiscard]] virtual int idle_timeout() const { return -1; };
+
     /**
      * Called when a down event (mouse or keyboard) happens.
      */
@@ -236,9 +267,14 @@ protected:
     void init() override;
 
     /**
-     * Renders the current top state.
+     * Renders the current top state, if it changed or an event happened.
+     */
+    bool render() override;
+
+    /**
+     * Returns the idle timeout of the current top state.
      */
-    void render() override;
+    [[nodiscard]] int idle_timeout() const override;
 
     /**
      * Ticks the current top state, and potentially changes to a new state.
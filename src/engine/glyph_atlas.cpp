@@ -0,0 +1,275 @@
+#include "glyph_atlas.h"
+#include "engine.h"
+#include "log.h"
+#include <algorithm>
+
+GlyphAtlas gGlyphAtlas;
+
+constexpr int ATLAS_INITIAL_SIZE = 256;
+constexpr int ATLAS_MAX_SIZE = 4096;
+constexpr int GLYPH_PADDING = 1;
+
+namespace {
+
+// Decodes utf-8 into codepoints. Invalid bytes become U+FFFD.
+void decode_utf8(const std::string &text, std::vector<Uint32> &out) {
+    out.clear();
+    std::size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = text[i];
+        int len;
+        Uint32 cp;
+        if (c < 0x80) {
+            out.push_back(c);
+            ++i;
+            continue;
+        } else if ((c & 0xe0) == 0xc0) {
+            len = 2;
+            cp = c & 0x1f;
+        } else if ((c & 0xf0) == 0xe0) {
+            len = 3;
+            cp = c & 0x0f;
+        } else if ((c & 0xf8) == 0xf0) {
+            len = 4;
+            cp = c & 0x07;
+        } else {
+            out.push_back(0xfffd);
+            ++i;
+            continue;
+        }
+        if (i + len > text.size()) {
+            out.push_back(0xfffd);
+            break;
+        }
+        bool valid = true;
+        for (int j = 1; j < len; ++j) {
+            unsigned char cont = text[i + j];
+            if ((cont & 0xc0) != 0x80) {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (cont & 0x3f);
+        }
+        if (!valid) {
+            out.push_back(0xfffd);
+            ++i;
+            continue;
+        }
+        out.push_back(cp);
+        i += len;
+    }
+}
+
+} // namespace
+
+GlyphAtlas::GlyphAtlas() : size{ATLAS_INITIAL_SIZE} { clear(); }
+
+void GlyphAtlas::set_font(TTF_Font *new_font) {
+    font = new_font;
+    font_height = TTF_FontHeight(font);
+    line_skip = TTF_FontLineSkip(font);
+    if (texture != nullptr) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+    clear();
+}
+
+void GlyphAtlas::clear() {
+    for (auto &g : ascii) {
+        g.advance = -1;
+    }
+    glyphs.clear();
+    row_x = 0;
+    row_y = 0;
+    row_h = 0;
+    ++generation;
+}
+
+void GlyphAtlas::free() {
+    if (texture != nullptr) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+    clear();
+}
+
+bool GlyphAtlas::create_texture() {
+    if (texture != nullptr) {
+        return true;
+    }
+    if (gRenderer == nullptr || font == nullptr) {
+        return false;
+    }
+    texture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_STATIC, size, size);
+    if (texture == nullptr) {
+        LOG_ERROR_CAT(LogCategory::ENGINE, "Failed creating glyph atlas: %s", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    clear();
+    // Rasterize printable ascii up front, most text never needs more.
+    for (Uint32 c = ' '; c < 127; ++c) {
+        get(c);
+    }
+    return true;
+}
+
+bool GlyphAtlas::allocate(int w, int h, SDL_Rect &rect) {
+    if (w + GLYPH_PADDING > size) {
+        return false;
+    }
+    if (row_x + w + GLYPH_PADDING > size) {
+        row_x = 0;
+        row_y += row_h + GLYPH_PADDING;
+        row_h = 0;
+    }
+    if (row_y + h + GLYPH_PADDING > size) {
+        if (size >= ATLAS_MAX_SIZE) {
+            return false;
+        }
+        LOG_DEBUG_CAT(LogCategory::ENGINE, "Growing glyph atlas to %d", size * 2);
+        size *= 2;
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+        return false;
+    }
+    rect = {row_x, row_y, w, h};
+    row_x += w + GLYPH_PADDING;
+    row_h = std::max(row_h, h);
+    return true;
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::get(Uint32 codepoint) {
+    if (codepoint < 128 && ascii[codepoint].advance >= 0) {
+        return &ascii[codepoint];
+    } else if (codepoint >= 128) {
+        auto it = glyphs.find(codepoint);
+        if (it != glyphs.end()) {
+            return &it->second;
+        }
+    }
+    if (!create_texture()) {
+        return nullptr;
+    }
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy,
+                           &advance) != 0) {
+        return nullptr;
+    }
+    Glyph glyph{{0, 0, 0, 0}, advance};
+    SDL_Surface *surface =
+        TTF_RenderGlyph32_Blended(font, codepoint, {0xff, 0xff, 0xff, 0xff});
+    if (surface != nullptr) {
+        SDL_Surface *converted =
+            SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (converted == nullptr) {
+            return nullptr;
+        }
+        if (converted->w > 0 && converted->h > 0) {
+            if (!allocate(converted->w, converted->h, glyph.rect)) {
+                SDL_FreeSurface(converted);
+                if (texture == nullptr) {
+                    // The atlas grew, everything is rasterized again.
+                    return get(codepoint);
+                }
+                LOG_WARNING_CAT(LogCategory::ENGINE, "Glyph atlas is full");
+                return nullptr;
+            }
+            SDL_UpdateTexture(texture, &glyph.rect, converted->pixels,
+                              converted->pitch);
+        }
+        SDL_FreeSurface(converted);
+    }
+    if (codepoint < 128) {
+        ascii[codepoint] = glyph;
+        return &ascii[codepoint];
+    }
+    return &(glyphs[codepoint] = glyph);
+}
+
+void GlyphAtlas::layout(const std::string &text, int wrap_width, SDL_Color color,
+                        std::vector<SDL_Vertex> &verticies,
+                        std::vector<int> &indices, int &width, int &height,
+                        const std::vector<SDL_Color> *char_colors) {
+    decode_utf8(text, codepoints);
+    auto advance = [this](Uint32 c) {
+        const Glyph *g = get(c);
+        return g == nullptr ? 0 : g->advance;
+    };
+    Uint32 gen;
+    do {
+        gen = generation;
+        verticies.clear();
+        indices.clear();
+        width = 0;
+        int lines = 0;
+        std::size_t n = codepoints.size();
+        std::size_t i = 0;
+        while (i < n) {
+            std::size_t start = i;
+            std::size_t end = i;
+            std::size_t space = n;
+            int x = 0;
+            for (; end < n && codepoints[end] != '\n'; ++end) {
+                int a = advance(codepoints[end]);
+                if (wrap_width > 0 && x + a > wrap_width && end > start) {
+                    break;
+                }
+                if (codepoints[end] == ' ') {
+                    space = end;
+                }
+                x += a;
+            }
+            if (end < n && codepoints[end] == '\n') {
+                i = end + 1;
+            } else if (end < n && space < end && space > start) {
+                // Wrap at the last space, like TTF_RenderUTF8_Blended_Wrapped.
+                end = space;
+                i = space + 1;
+            } else {
+                i = end;
+            }
+            while (end > start && codepoints[end - 1] == ' ') {
+                --end;
+            }
+
+            int y = lines * line_skip;
+            x = 0;
+            for (std::size_t j = start; j < end; ++j) {
+                const Glyph *g = get(codepoints[j]);
+                if (g == nullptr) {
+                    continue;
+                }
+                if (g->rect.w > 0) {
+                    float u0 = static_cast<float>(g->rect.x) / size;
+                    float v0 = static_cast<float>(g->rect.y) / size;
+                    float u1 = static_cast<float>(g->rect.x + g->rect.w) / size;
+                    float v1 = static_cast<float>(g->rect.y + g->rect.h) / size;
+                    float x0 = static_cast<float>(x);
+                    float y0 = static_cast<float>(y);
+                    float x1 = x0 + g->rect.w;
+                    float y1 = y0 + g->rect.h;
+                    SDL_Color c = color;
+                    if (char_colors != nullptr && j < char_colors->size()) {
+                        c = (*char_colors)[j];
+                    }
+                    int base = static_cast<int>(verticies.size());
+                    verticies.push_back({{x0, y0}, c, {u0, v0}});
+                    verticies.push_back({{x1, y0}, c, {u1, v0}});
+                    verticies.push_back({{x1, y1}, c, {u1, v1}});
+                    verticies.push_back({{x0, y1}, c, {u0, v1}});
+                    indices.insert(indices.end(), {base, base + 1, base + 2,
+                                                   base, base + 2, base + 3});
+                }
+                x += g->advance;
+            }
+            width = std::max(width, x);
+            ++lines;
+        }
+        height = lines == 0 ? 0 : (lines - 1) * line_skip + font_height;
+        // Rasterizing a glyph can grow the atlas, which moves all glyphs.
+    } while (gen != generation);
+}
@@ -0,0 +1,103 @@
+#ifndef GLYPH_ATLAS_00_H
+#define GLYPH_ATLAS_00_H
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The glyphs of a font, rasterized once into a single texture so that text
+ * can be drawn as textured quads with SDL_RenderGeometry.
+ * Glyphs are white, text gets its color from the vertex colors.
+ */
+class GlyphAtlas {
+public:
+    struct Glyph {
+        // Position in the atlas texture, empty for blank glyphs.
+        SDL_Rect rect;
+        int advance;
+    };
+
+    GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    /**
+     * Sets the font glyphs are rasterized from, discarding all glyphs.
+     * Has to be called again after the size or DPI of the font changes.
+     */
+    void set_font(TTF_Font *font);
+
+    /**
+     * Returns the glyph of codepoint, rasterizing it if needed.
+     * Returns nullptr if there is no renderer yet or the atlas is full.
+     */
+    const Glyph *get(Uint32 codepoint);
+
+    /**
+     * Lays out text from (0, 0), wrapping lines at spaces to fit wrap_width
+     * pixels, and at newlines. Replaces the contents of verticies and
+     * indices with two triangles per glyph. Only uploads to the GPU if text
+     * contains glyphs that are not yet rasterized.
+     *
+     * @param width set to the width of the widest line.
+     * @param height set to the height of all lines.
+     * @param char_colors optional color per codepoint, overriding color.
+     */
+    void layout(const std::string &text, int wrap_width, SDL_Color color,
+                std::vector<SDL_Vertex> &verticies, std::vector<int> &indices,
+                int &width, int &height,
+                const std::vector<SDL_Color> *char_colors = nullptr);
+
+    /**
+     * Returns the height of a single line.
+     */
+    int line_height() const { return font_height; }
+
+    SDL_Texture *get_texture() const { return texture; }
+
+    /**
+     * Incremented whenever glyphs move in or are removed from the atlas.
+     * Layouts made with an older generation have to be redone.
+     */
+    Uint32 get_generation() const { return generation; }
+
+    /**
+     * Destroys the atlas texture. Has to be called before the renderer is
+     * destroyed.
+     */
+    void free();
+
+private:
+    bool create_texture();
+
+    // Finds space for a w x h glyph, growing the atlas if needed.
+    bool allocate(int w, int h, SDL_Rect &rect);
+
+    void clear();
+
+    TTF_Font *font = nullptr;
+    SDL_Texture *texture = nullptr;
+    int size;
+
+    // Glyphs are packed left to right in rows.
+    int row_x = 0;
+    int row_y = 0;
+    int row_h = 0;
+
+    int font_height = 0;
+    int line_skip = 0;
+
+    Uint32 generation = 0;
+
+    Glyph ascii[128];
+    std::unordered_map<Uint32, Glyph> glyphs{};
+
+    std::vector<Uint32> codepoints{};
+};
+
+extern GlyphAtlas gGlyphAtlas;
+
+#endif
@@ -1,4 +1,5 @@
 #include "input.h"
+#include "log.h"
 
 std::string get_input_name(const SDL_Keycode key, const Uint32 mouse) {
 	if (mouse == SDL_BUTTON_LEFT) {
@@ -20,7 +21,7 @@ std::unique_ptr<PressInput> get_press_input(const std::string& name, const std::
 	try {
 		return get_press_input(name);
 	} catch (const binding_exception&) {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+        LOG_WARNING_CAT(LogCategory::ENGINE,
                     R"(Invalid key "%s", using "%s")", name.c_str(), default_name.c_str());
 		return get_press_input(default_name);
 	}
@@ -30,7 +31,7 @@ std::unique_ptr<HoldInput> get_hold_input(const std::string& name, const std::st
 	try {
 		return get_hold_input(name);
 	} catch (const binding_exception&) {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+        LOG_WARNING_CAT(LogCategory::ENGINE,
                     R"(Invalid key "%s", using "%s")", name.c_str(), default_name.c_str());
 		return get_hold_input(default_name);
 	}	
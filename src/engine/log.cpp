@@ -0,0 +1,451 @@
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// How long the logging thread sleeps when nobody wakes it, in ms.
+constexpr int LOG_WAKE_DELAY = 20;
+// Number of records in the ring buffer, must be a power of two.
+constexpr std::size_t LOG_RING_SIZE = 1024;
+
+uint8_t LogRecord::add_text(const char *s) {
+    if (text_size == TEXT_SIZE) {
+        // Full, share the terminator of the last string.
+        return TEXT_SIZE - 1;
+    }
+    uint8_t offset = text_size;
+    std::size_t len = std::min(std::strlen(s), TEXT_SIZE - text_size - 1);
+    std::memcpy(text + text_size, s, len);
+    text_size = static_cast<uint8_t>(text_size + len);
+    text[text_size++] = '\0';
+    return offset;
+}
+
+namespace {
+
+/**
+ * Bounded queue of records, written by any thread and read by the logging
+ * thread. Each cell carries a sequence number telling whose turn it is,
+ * so neither side takes a lock.
+ */
+class LogRing {
+public:
+    LogRing() {
+        for (std::size_t i = 0; i < LOG_RING_SIZE; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord *claim() {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & MASK];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return &cell.record;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commit(LogRecord *record) {
+        Cell *cell = reinterpret_cast<Cell *>(record);
+        std::size_t pos = cell->seq.load(std::memory_order_relaxed);
+        cell->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    /**
+     * The oldest committed record, or nullptr. Only used by the logging thread.
+     */
+    LogRecord *front() {
+        Cell &cell = cells[head & MASK];
+        if (cell.seq.load(std::memory_order_acquire) != head + 1) {
+            return nullptr;
+        }
+        return &cell.record;
+    }
+
+    /**
+     * Returns the record from front to the writers.
+     */
+    void pop() {
+        cells[head & MASK].seq.store(head + LOG_RING_SIZE, std::memory_order_release);
+        ++head;
+        popped.store(head, std::memory_order_release);
+    }
+
+    std::size_t claimed() const { return tail.load(std::memory_order_acquire); }
+
+    std::size_t written() const { return popped.load(std::memory_order_acquire); }
+
+private:
+    static constexpr std::size_t MASK = LOG_RING_SIZE - 1;
+    static_assert((LOG_RING_SIZE & MASK) == 0, "LOG_RING_SIZE must be a power of two");
+
+    // The record comes first, so a record pointer is also a cell pointer.
+    struct Cell {
+        LogRecord record;
+        std::atomic<std::size_t> seq;
+    };
+    static_assert(std::is_standard_layout_v<Cell>, "Cell must be standard layout");
+
+    Cell cells[LOG_RING_SIZE];
+    alignas(64) std::atomic<std::size_t> tail {0};
+    alignas(64) std::size_t head {0};
+    std::atomic<std::size_t> popped {0};
+};
+
+/**
+ * Formats one conversion of format, starting at its '%', appending it to out.
+ * Integer conversions are widened to 64 bits, so the length modifier written
+ * in the format does not matter. Returns the position after the conversion.
+ */
+const char *format_arg(const char *format, const LogRecord &record, int &arg, std::string &out) {
+    std::string spec = "%";
+    const char *p = format + 1;
+    auto next_int = [&]() -> long long {
+        if (arg >= record.arg_count) {
+            return 0;
+        }
+        return static_cast<long long>(record.args[arg++]);
+    };
+    while (std::strchr("-+ #0", *p) != nullptr && *p != '\0') {
+        spec += *p++;
+    }
+    for (int part = 0; part < 2; ++part) {
+        if (part == 1) {
+            if (*p != '.') {
+                break;
+            }
+            spec += *p++;
+        }
+        if (*p == '*') {
+            spec += std::to_string(next_int());
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec += *p++;
+        }
+    }
+    while (std::strchr("hlLqjzt", *p) != nullptr && *p != '\0') {
+        ++p;
+    }
+    char conv = *p;
+    if (conv == '\0') {
+        return p;
+    }
+    ++p;
+    if (conv == '%') {
+        out += '%';
+        return p;
+    }
+    if (arg >= record.arg_count) {
+        out += "(missing)";
+        return p;
+    }
+    LogRecord::ArgType type = record.types[arg];
+    uint64_t val = record.args[arg++];
+    double d;
+    std::memcpy(&d, &val, sizeof(d));
+
+    char buf[128];
+    int len;
+    switch (conv) {
+    case 'd':
+    case 'i':
+        spec += "ll";
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(),
+                            type == LogRecord::DOUBLE ? static_cast<long long>(d)
+                                                      : static_cast<long long>(val));
+        break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        spec += "ll";
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(),
+                            type == LogRecord::DOUBLE ? static_cast<unsigned long long>(d)
+                                                      : static_cast<unsigned long long>(val));
+        break;
+    case 'c':
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(), static_cast<int>(val));
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(),
+                            type == LogRecord::DOUBLE  ? d
+                            : type == LogRecord::INT ? static_cast<double>(static_cast<int64_t>(val))
+                                                     : static_cast<double>(val));
+        break;
+    case 's':
+        if (type != LogRecord::STRING) {
+            out += "(invalid)";
+            return p;
+        }
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(), record.text + val);
+        if (len >= static_cast<int>(sizeof(buf))) {
+            // Long strings without width or precision are copied as is.
+            if (spec == "%s") {
+                out += record.text + val;
+                return p;
+            }
+        }
+        break;
+    case 'p':
+        spec += conv;
+        len = std::snprintf(buf, sizeof(buf), spec.c_str(), reinterpret_cast<void *>(val));
+        break;
+    default:
+        out += "(invalid)";
+        return p;
+    }
+    if (len > 0) {
+        out.append(buf, std::min(static_cast<std::size_t>(len), sizeof(buf) - 1));
+    }
+    return p;
+}
+
+void format_record(const LogRecord &record, std::string &out) {
+    out.clear();
+    int arg = 0;
+    const char *p = record.format;
+    while (*p != '\0') {
+        const char *next = std::strchr(p, '%');
+        if (next == nullptr) {
+            out += p;
+            break;
+        }
+        out.append(p, next);
+        p = format_arg(next, record, arg, out);
+    }
+    // Every message is a single line of the log, as tools reading it expect.
+    while (!out.empty() && (out.back() == '\n' || out.back() == '\r')) {
+        out.pop_back();
+    }
+}
+
+void output(const LogRecord &record, std::string &line) {
+    format_record(record, line);
+    SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, record.priority, "%s", line.c_str());
+}
+
+/**
+ * Owns the ring buffer and the thread formatting its records.
+ * The thread is started on first use, and stopped at exit after
+ * writing everything left in the buffer.
+ */
+class Logger {
+public:
+    LogRecord *claim() {
+        if (stopped.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        std::call_once(started, [this]() { start(); });
+        LogRecord *record = ring.claim();
+        if (record == nullptr) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return record;
+    }
+
+    void commit(LogRecord *record) {
+        // Wake the thread early for problems, and before the buffer fills up.
+        bool urgent = record->priority >= SDL_LOG_PRIORITY_WARN ||
+                      ring.claimed() - ring.written() >= LOG_RING_SIZE / 2;
+        ring.commit(record);
+        if (urgent) {
+            cond.notify_one();
+        }
+    }
+
+    bool is_stopped() const { return stopped.load(std::memory_order_acquire); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            quit = true;
+        }
+        cond.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+private:
+    void start() {
+        // Filtering happens before records are queued.
+        SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_VERBOSE);
+        thread = std::thread(&Logger::run, this);
+        std::atexit([]() { shutdown(); });
+    }
+
+    static void shutdown();
+
+    void drain(std::string &line) {
+        std::size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN,
+                           "%zu log messages dropped", lost);
+        }
+        while (LogRecord *record = ring.front()) {
+            output(*record, line);
+            ring.pop();
+        }
+    }
+
+    void run() {
+        std::string line;
+        std::unique_lock<std::mutex> lock{mutex};
+        while (!quit) {
+            lock.unlock();
+            drain(line);
+            lock.lock();
+            cond.wait_for(lock, std::chrono::milliseconds(LOG_WAKE_DELAY));
+        }
+        lock.unlock();
+        // Messages committed after this point are written by their own thread.
+        stopped.store(true, std::memory_order_release);
+        drain(line);
+        while (ring.written() < ring.claimed()) {
+            std::this_thread::yield();
+            drain(line);
+        }
+    }
+
+    LogRing ring {};
+    std::atomic<std::size_t> dropped {0};
+    std::atomic<bool> stopped {false};
+
+    std::once_flag started {};
+    std::thread thread {};
+    std::mutex mutex {};
+    std::condition_variable cond {};
+    bool quit = false;
+};
+
+// Never destroyed, so messages from destructors running at exit are still written.
+Logger &logger() {
+    static Logger *instance = new Logger();
+    return *instance;
+}
+
+void Logger::shutdown() { logger().stop(); }
+
+// Record for messages written after the logging thread stopped.
+thread_local LogRecord direct_record;
+
+}
+
+namespace logging {
+
+std::atomic<uint8_t> priorities[static_cast<int>(LogCategory::COUNT)] = {
+    SDL_LOG_PRIORITY_INFO, SDL_LOG_PRIORITY_INFO, SDL_LOG_PRIORITY_INFO,
+    SDL_LOG_PRIORITY_INFO, SDL_LOG_PRIORITY_INFO};
+
+void set_priority(SDL_LogPriority priority) {
+    for (auto &p : priorities) {
+        p.store(static_cast<uint8_t>(priority), std::memory_order_relaxed);
+    }
+}
+
+void set_priority(LogCategory category, SDL_LogPriority priority) {
+    priorities[static_cast<int>(category)].store(static_cast<uint8_t>(priority),
+                                                 std::memory_order_relaxed);
+}
+
+LogRecord *claim(LogCategory category, SDL_LogPriority priority, const char *format) {
+    Logger &log = logger();
+    LogRecord *record = log.claim();
+    if (record == nullptr) {
+        if (!log.is_stopped()) {
+            return nullptr;
+        }
+        record = &direct_record;
+    }
+    record->format = format;
+    record->category = category;
+    record->priority = priority;
+    record->arg_count = 0;
+    record->text_size = 0;
+    return record;
+}
+
+void commit(LogRecord *record) {
+    if (record == &direct_record) {
+        std::string line;
+        output(*record, line);
+        return;
+    }
+    logger().commit(record);
+}
+
+void check_format(const char *, ...) {}
+
+bool configure(const char *spec) {
+    static const char *const CATEGORY_NAMES[] = {"general", "engine", "editor", "compiler",
+                                                 "processor"};
+    static const char *const PRIORITY_NAMES[] = {"verbose", "debug", "info",
+                                                 "warning", "error", "critical"};
+    static_assert(std::size(CATEGORY_NAMES) == static_cast<std::size_t>(LogCategory::COUNT),
+                  "Every category needs a name");
+    bool ok = true;
+    std::string entry;
+    const char *p = spec;
+    while (true) {
+        const char *end = std::strchr(p, ',');
+        entry.assign(p, end == nullptr ? std::strlen(p) : static_cast<std::size_t>(end - p));
+
+        std::size_t eq = entry.find('=');
+        std::string category = eq == std::string::npos ? "" : entry.substr(0, eq);
+        std::string priority = eq == std::string::npos ? entry : entry.substr(eq + 1);
+        int cat = -1, prio = -1;
+        for (int i = 0; i < static_cast<int>(std::size(CATEGORY_NAMES)); ++i) {
+            if (category == CATEGORY_NAMES[i]) {
+                cat = i;
+            }
+        }
+        for (int i = 0; i < static_cast<int>(std::size(PRIORITY_NAMES)); ++i) {
+            if (priority == PRIORITY_NAMES[i]) {
+                prio = SDL_LOG_PRIORITY_VERBOSE + i;
+            }
+        }
+        if (prio < 0 || (cat < 0 && !category.empty())) {
+            ok = ok && entry.empty();
+        } else if (cat < 0) {
+            set_priority(static_cast<SDL_LogPriority>(prio));
+        } else {
+            set_priority(static_cast<LogCategory>(cat), static_cast<SDL_LogPriority>(prio));
+        }
+
+        if (end == nullptr) {
+            return ok;
+        }
+        p = end + 1;
+    }
+}
+
+}
@@ -1,9 +1,179 @@
-#pragma once
+#ifndef LOG_00_H
+#define LOG_00_H
 #include <SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
+/**
+ * Messages above LOG_LEVEL are removed at compile time, arguments included.
+ * Defaults to LOG_LEVEL_INFO in release builds and LOG_LEVEL_DEBUG otherwise.
+ */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_CRITICAL 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_INFO 4
+#define LOG_LEVEL_DEBUG 5
 
-#define LOG_CRITICAL(...) SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
-#define LOG_ERROR(...) SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
-#define LOG_WARNING(...) SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
-#define LOG_INFO(...) SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
-#define LOG_DEBUG(...) SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+/**
+ * Categories with separate runtime priorities.
+ */
+enum class LogCategory : uint8_t { GENERAL, ENGINE, EDITOR, COMPILER, PROCESSOR, COUNT };
+
+/**
+ * A message as written by the logging thread: the format string, which must
+ * be a literal, and the raw arguments. String arguments are copied into text.
+ */
+struct LogRecord {
+    static constexpr int MAX_ARGS = 8;
+    static constexpr std::size_t TEXT_SIZE = 160;
+
+    enum ArgType : uint8_t { INT, UINT, DOUBLE, POINTER, STRING };
+
+    const char *format;
+    LogCategory category;
+    SDL_LogPriority priority;
+    uint8_t arg_count;
+    uint8_t text_size;
+    ArgType types[MAX_ARGS];
+    uint64_t args[MAX_ARGS];
+    char text[TEXT_SIZE];
+
+    template <class T> void add(T arg) {
+        using U = std::decay_t<T>;
+        uint64_t &val = args[arg_count];
+        ArgType &type = types[arg_count++];
+        if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, const char *>) {
+            type = STRING;
+            val = add_text(arg == nullptr ? "(null)" : arg);
+        } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+            type = POINTER;
+            val = reinterpret_cast<uintptr_t>(static_cast<const void *>(arg));
+        } else if constexpr (std::is_floating_point_v<U>) {
+            type = DOUBLE;
+            double d = static_cast<double>(arg);
+            std::memcpy(&val, &d, sizeof(d));
+        } else if constexpr (std::is_enum_v<U>) {
+            type = INT;
+            val = static_cast<uint64_t>(static_cast<int64_t>(arg));
+        } else {
+            static_assert(std::is_integral_v<U>, "Unsupported log argument");
+            type = std::is_signed_v<U> ? INT : UINT;
+            val = static_cast<uint64_t>(arg);
+        }
+    }
+
+private:
+    // Copies a string argument into text, truncating it when text is full.
+    // Returns its offset.
+    uint8_t add_text(const char *s);
+};
+
+namespace logging {
+
+extern std::atomic<uint8_t> priorities[static_cast<int>(LogCategory::COUNT)];
+
+/**
+ * Sets the lowest priority written, for every category.
+ */
+void set_priority(SDL_LogPriority priority);
+
+void set_priority(LogCategory category, SDL_LogPriority priority);
+
+inline bool enabled(LogCategory category, SDL_LogPriority priority) {
+    return priority >= priorities[static_cast<int>(category)].load(std::memory_order_relaxed);
+}
+
+/**
+ * Claims a record in the ring buffer, filling in the header.
+ * Returns nullptr if the buffer is full, the message is then dropped.
+ * After logging has shut down, returns a record owned by the calling thread.
+ */
+LogRecord *claim(LogCategory category, SDL_LogPriority priority, const char *format);
+
+/**
+ * Hands a claimed record to the logging thread, which formats it later.
+ */
+void commit(LogRecord *record);
+
+/**
+ * Sets priorities from a list such as "debug" or "compiler=debug,engine=info".
+ * Entries without a category apply to all categories, later entries win.
+ * Returns false if an entry was not understood, the rest still apply.
+ */
+bool configure(const char *spec);
+
+/**
+ * Never called, only gives the compiler a printf like signature to check
+ * the format and arguments of log messages against.
+ */
+void check_format(SDL_PRINTF_FORMAT_STRING const char *format, ...) SDL_PRINTF_VARARG_FUNC(1);
+
+template <class... Args>
+void write(LogCategory category, SDL_LogPriority priority, const char *format,
+           const Args &...args) {
+    static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "Too many log arguments");
+    LogRecord *record = claim(category, priority, format);
+    if (record == nullptr) {
+        return;
+    }
+    (record->add(args), ...);
+    commit(record);
+}
+
+}
+
+#define LOG_WRITE(category, priority, ...)                                                         \
+    ((void)(false && (::logging::check_format(__VA_ARGS__), true)),                                \
+     ::logging::enabled(category, priority) ? ::logging::write(category, priority, __VA_ARGS__)    \
+                                            : void())
+
+#if LOG_LEVEL >= LOG_LEVEL_CRITICAL
+#define LOG_CRITICAL_CAT(category, ...) LOG_WRITE(category, SDL_LOG_PRIORITY_CRITICAL, __VA_ARGS__)
+#else
+#define LOG_CRITICAL_CAT(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR_CAT(category, ...) LOG_WRITE(category, SDL_LOG_PRIORITY_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR_CAT(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING_CAT(category, ...) LOG_WRITE(category, SDL_LOG_PRIORITY_WARN, __VA_ARGS__)
+#else
+#define LOG_WARNING_CAT(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO_CAT(category, ...) LOG_WRITE(category, SDL_LOG_PRIORITY_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO_CAT(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG_CAT(category, ...) LOG_WRITE(category, SDL_LOG_PRIORITY_DEBUG, __VA_ARGS__)
+#define LOG_DEBUG_ENABLED(category) ::logging::enabled(category, SDL_LOG_PRIORITY_DEBUG)
+#else
+#define LOG_DEBUG_CAT(category, ...) ((void)0)
+#define LOG_DEBUG_ENABLED(category) false
+#endif
+
+#define LOG_CRITICAL(...) LOG_CRITICAL_CAT(LogCategory::GENERAL, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_ERROR_CAT(LogCategory::GENERAL, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_WARNING_CAT(LogCategory::GENERAL, __VA_ARGS__)
+#define LOG_INFO(...) LOG_INFO_CAT(LogCategory::GENERAL, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_DEBUG_CAT(LogCategory::GENERAL, __VA_ARGS__)
+
+#endif
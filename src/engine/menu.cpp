@@ -34,6 +34,8 @@ void Menu::render() {
     comps.render(0, 0);
 }
 
+bool Menu::is_dirty() const { return comps.is_dirty(); }
+
 void Menu::tick(const Uint64 delta, StateStatus &res) {
     res = next_res;
     next_res.action = StateStatus::NONE;
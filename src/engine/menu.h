@@ -27,6 +27,8 @@ public:
      */
     void render() override;
 
+    bool is_dirty() const override;
+
     /**
      * Ticks the menu, deciding if to switch state.
      */
@@ -1,10 +1,122 @@
-#include <chrono>
-#include <random>
+#include "random.h"
 #include "engine.h"
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
-std::minstd_rand generator(static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count()));
+namespace {
+
+uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+// High 64 bits and low 64 bits of a * b.
+uint64_t mul_128(uint64_t a, uint64_t b, uint64_t &low) {
+#ifdef _MSC_VER
+    uint64_t high;
+    low = _umul128(a, b, &high);
+    return high;
+#else
+    unsigned __int128 res = static_cast<unsigned __int128>(a) * b;
+    low = static_cast<uint64_t>(res);
+    return static_cast<uint64_t>(res >> 64);
+#endif
+}
+
+constexpr uint64_t JUMP[4] = {0x180EC6D33CFD0ABA, 0xD5A61266F0C9392C, 0xA9582618E03FC9AA,
+                              0x39ABDC4529B1661C};
+
+constexpr uint64_t LONG_JUMP[4] = {0x76E15D3EFEFDCBBF, 0xC5004E441C522FB3, 0x77710069854EE241,
+                                   0x39109BB02ACBE635};
+
+}
+
+Random::Random(uint64_t seed) {
+    for (auto &v : s) {
+        v = splitmix64(seed);
+    }
+}
+
+void Random::jump(const uint64_t (&table)[4]) {
+    uint64_t res[4] = {0, 0, 0, 0};
+    for (uint64_t word : table) {
+        for (int b = 0; b < 64; ++b) {
+            if (word & (uint64_t{1} << b)) {
+                for (int i = 0; i < 4; ++i) {
+                    res[i] ^= s[i];
+                }
+            }
+            next();
+        }
+    }
+    std::memcpy(s, res, sizeof(s));
+}
+
+void Random::jump() { jump(JUMP); }
+
+void Random::long_jump() { jump(LONG_JUMP); }
+
+Random Random::split(uint64_t index) const {
+    // Hash the whole state with the index, the new generator seeds from that.
+    uint64_t x = index;
+    uint64_t seed = 0;
+    for (uint64_t v : s) {
+        x ^= v;
+        seed = rotl(seed, 23) ^ splitmix64(x);
+    }
+    return Random{seed};
+}
+
+uint64_t Random::below(uint64_t bound) {
+    // Lemire's method: the high half of value * bound is uniform once the
+    // few low halves that would make it uneven are rejected.
+    uint64_t low;
+    uint64_t high = mul_128(next(), bound, low);
+    if (low < bound) {
+        uint64_t threshold = (0 - bound) % bound;
+        while (low < threshold) {
+            high = mul_128(next(), bound, low);
+        }
+    }
+    return high;
+}
+
+int64_t Random::range(int64_t min, int64_t max) {
+    if (min >= max) {
+        return min;
+    }
+    uint64_t span = static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+    return static_cast<int64_t>(static_cast<uint64_t>(min) + below(span));
+}
+
+void Random::fill(void *data, std::size_t size) {
+    // Bytes are taken from the low end, so the data is the same on any
+    // byte order.
+    auto *out = static_cast<unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t v = next();
+        for (std::size_t j = i; j < size && j < i + sizeof(uint64_t); ++j) {
+            out[j] = static_cast<unsigned char>(v);
+            v >>= 8;
+        }
+    }
+}
+
+namespace {
+
+// Generator of engine::random, one per thread, seeded by seed_random.
+thread_local Random thread_generator{Random{0}.split(0)};
+
+}
+
+void engine::seed_random(uint64_t seed, uint64_t stream) {
+    thread_generator = Random{seed}.split(stream);
+}
 
 int engine::random(const int min, const int max) {
-    if (min >= max) return min;
-    return (static_cast<int>(generator()) % (max - min)) + min;
+    return static_cast<int>(thread_generator.range(min, max));
 }
@@ -0,0 +1,97 @@
+#ifndef RANDOM_00_H
+#define RANDOM_00_H
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Seedable xoshiro256** generator. Equal seeds give equal sequences on every
+ * platform, so generated data can be reproduced. Not thread safe, give each
+ * thread its own generator through jump or split instead.
+ * Satisfies UniformRandomBitGenerator, so it also works with <random>.
+ */
+class Random {
+public:
+    using result_type = uint64_t;
+
+    explicit Random(uint64_t seed = 0);
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    result_type operator()() { return next(); }
+
+    uint64_t next() {
+        uint64_t res = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return res;
+    }
+
+    /**
+     * Advances by 2^128 values. Calling it once per worker on copies of one
+     * generator gives streams that never overlap.
+     */
+    void jump();
+
+    /**
+     * Advances by 2^192 values, for splitting streams that are jumped again.
+     */
+    void long_jump();
+
+    /**
+     * Returns a generator for index, derived from the current state without
+     * changing it. The result only depends on the state and index, so the
+     * generator of a test case is the same whichever thread creates it.
+     */
+    Random split(uint64_t index) const;
+
+    /**
+     * Returns a value in [0, bound), without the bias of taking a modulo.
+     * bound must not be 0.
+     */
+    uint64_t below(uint64_t bound);
+
+    /**
+     * Returns a value between min (inclusive) and max (exclusive),
+     * or min if the range is empty.
+     */
+    int64_t range(int64_t min, int64_t max);
+
+    /**
+     * Fills size bytes of data with random bits.
+     */
+    void fill(void *data, std::size_t size);
+
+    /**
+     * Fills data with values between min (inclusive) and max (exclusive).
+     */
+    template <class T> void fill(T *data, std::size_t size, T min, T max) {
+        static_assert(std::is_integral_v<T>, "fill needs an integer type");
+        if (min >= max) {
+            for (std::size_t i = 0; i < size; ++i) {
+                data[i] = min;
+            }
+            return;
+        }
+        uint64_t span = static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+        for (std::size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<T>(static_cast<uint64_t>(min) + below(span));
+        }
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    void jump(const uint64_t (&table)[4]);
+
+    uint64_t s[4];
+};
+
+#endif
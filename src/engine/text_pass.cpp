@@ -0,0 +1,46 @@
+#include "text_pass.h"
+#include "engine.h"
+#include "glyph_atlas.h"
+
+TextPass gTextPass;
+
+void TextPass::begin() { ++depth; }
+
+void TextPass::end() {
+    if (depth > 0 && --depth == 0) {
+        flush();
+    }
+}
+
+void TextPass::add(const std::vector<SDL_Vertex> &new_verticies,
+                   const std::vector<int> &new_indices, double new_dpi_ratio,
+                   const WindowState &new_window_state) {
+    if (!verticies.empty() && (new_dpi_ratio != dpi_ratio || &new_window_state != window_state)) {
+        flush();
+    }
+    dpi_ratio = new_dpi_ratio;
+    window_state = &new_window_state;
+    int base = static_cast<int>(verticies.size());
+    verticies.insert(verticies.end(), new_verticies.begin(), new_verticies.end());
+    for (int ix : new_indices) {
+        indices.push_back(base + ix);
+    }
+}
+
+void TextPass::flush() {
+    if (indices.empty()) {
+        verticies.clear();
+        return;
+    }
+    // Text is positioned in window pixels for better quality, so the logical
+    // size is the size of the window while it is drawn.
+    SDL_RenderSetLogicalSize(gRenderer, dpi_ratio * window_state->screen_width,
+                             dpi_ratio * window_state->screen_height);
+    SDL_RenderGeometry(gRenderer, gGlyphAtlas.get_texture(), verticies.data(),
+                       static_cast<int>(verticies.size()), indices.data(),
+                       static_cast<int>(indices.size()));
+    SDL_RenderSetLogicalSize(gRenderer, window_state->screen_width,
+                             window_state->screen_height);
+    verticies.clear();
+    indices.clear();
+}
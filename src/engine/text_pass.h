@@ -0,0 +1,51 @@
+#ifndef TEXT_PASS_00_H
+#define TEXT_PASS_00_H
+#include "game.h"
+#include <SDL.h>
+#include <vector>
+
+/**
+ * Collects the glyph quads of many text boxes, so they can be drawn with a
+ * single logical size change and a single SDL_RenderGeometry call.
+ * Anything drawn while a pass is active ends up below its text.
+ */
+class TextPass {
+public:
+    /**
+     * Starts collecting text. Passes nest, text is only drawn when the
+     * outermost pass ends.
+     */
+    void begin();
+
+    /**
+     * Ends a pass, drawing the collected text if it was the outermost one.
+     */
+    void end();
+
+    bool is_active() const { return depth > 0; }
+
+    /**
+     * Adds glyph quads, positioned in window pixels for dpi_ratio.
+     * Draws what was collected first if dpi_ratio changed.
+     */
+    void add(const std::vector<SDL_Vertex> &verticies, const std::vector<int> &indices,
+             double dpi_ratio, const WindowState &window_state);
+
+    /**
+     * Draws all collected text.
+     */
+    void flush();
+
+private:
+    int depth = 0;
+
+    double dpi_ratio = 0.0;
+    const WindowState *window_state = nullptr;
+
+    std::vector<SDL_Vertex> verticies{};
+    std::vector<int> indices{};
+};
+
+extern TextPass gTextPass;
+
+#endif
@@ -1,6 +1,8 @@
 #include "ui.h"
 #include "engine/log.h"
 #include "style.h"
+#include "text_pass.h"
+#include <algorithm>
 #include <utility>
 
 TTF_Font *TextBox::font;
@@ -10,6 +12,7 @@ void TextBox::init(TTF_Font *font_data) {
     if (TextBox::font == nullptr) {
         throw game_exception(std::string(TTF_GetError()));
     }
+    gGlyphAtlas.set_font(font);
 }
 
 TextBox::TextBox(SDL_Rect rect, std::string text, const WindowState &ws)
@@ -25,47 +28,34 @@ TextBox::TextBox(int x, int y, int w, int h, std::string text, int font_size,
       dpi_ratio(std::min(static_cast<double>(window_state.window_width) /
                              window_state.screen_width,
                          static_cast<double>(window_state.window_height) /
-                             window_state.screen_height)),
-      texture((SDL_Texture *)nullptr, 0, 0) {
+                             window_state.screen_height)) {
     set_text_color(UI_TEXT_COLOR);
+    generate_layout();
 }
 
-void TextBox::generate_texture() {
-    if (text.empty()) {
-        texture.free();
-        return;
-    }
-
-    SDL_Surface *text_surface =
-        TTF_RenderUTF8_Blended_Wrapped(font, text.c_str(), color, w);
-    if (text_surface == nullptr) {
-        throw image_load_exception(std::string(TTF_GetError()));
-    }
-    int width = text_surface->w;
-    int height = text_surface->h;
-    SDL_Texture *text_texture =
-        SDL_CreateTextureFromSurface(gRenderer, text_surface);
-    SDL_FreeSurface(text_surface);
-
-    if (text_texture == nullptr) {
-        throw image_load_exception(std::string(SDL_GetError()));
-    }
-    texture = Texture(text_texture, width, height);
+void TextBox::generate_layout() const {
+    placed_x = 0.0f;
+    placed_y = 0.0f;
+    atlas_generation = gGlyphAtlas.get_generation();
+    gGlyphAtlas.layout(text, w, color, verticies, indices, text_w, text_h,
+                       char_colors.empty() ? nullptr : &char_colors);
+    update_offsets();
+}
 
-    TTF_SizeUTF8(font, text.c_str(), &width, &height);
+void TextBox::update_offsets() const {
     if (alignment == Alignment::LEFT) {
         text_offset_x = 0;
     } else if (alignment == Alignment::CENTRE) {
-        text_offset_x = static_cast<int>((w - width / dpi_ratio) / 2);
+        text_offset_x = static_cast<int>((w - text_w / dpi_ratio) / 2);
     } else {
-        text_offset_x = static_cast<int>(w - width / dpi_ratio);
+        text_offset_x = static_cast<int>(w - text_w / dpi_ratio);
     }
-    text_offset_y = static_cast<int>((h - height / dpi_ratio) / 2);
+    text_offset_y = static_cast<int>((h - text_h / dpi_ratio) / 2);
 }
 
 void TextBox::set_dpi_ratio(double dpi) {
     dpi_ratio = dpi;
-    generate_texture();
+    generate_layout();
 }
 
 void TextBox::set_position(const int new_x, const int new_y) {
@@ -75,35 +65,39 @@ void TextBox::set_position(const int new_x, const int new_y) {
 
 void TextBox::set_text(const std::string &new_text) {
     text = new_text;
-    generate_texture();
+    char_colors.clear();
+    generate_layout();
+}
+
+void TextBox::set_text(const std::string &new_text,
+                       std::vector<SDL_Color> colors) {
+    text = new_text;
+    char_colors = std::move(colors);
+    generate_layout();
 }
 
 void TextBox::set_align(Alignment align) {
     alignment = align;
-    if (align == Alignment::LEFT) {
-        text_offset_x = 0;
-    } else if (align == Alignment::CENTRE) {
-        int width, height;
-        TTF_SizeUTF8(font, text.c_str(), &width, &height);
-        text_offset_x = static_cast<int>((w - width / dpi_ratio) / 2);
-    } else {
-        int width, height;
-        TTF_SizeUTF8(font, text.c_str(), &width, &height);
-        text_offset_x = static_cast<int>(w - width / dpi_ratio);
-    }
+    update_offsets();
 }
 
 void TextBox::set_text_color(const Uint8 r, const Uint8 g, const Uint8 b,
                              const Uint8 a) {
     color = {r, g, b, a};
-    generate_texture();
+    if (!char_colors.empty()) {
+        generate_layout();
+        return;
+    }
+    for (auto &v : verticies) {
+        v.color = color;
+    }
 }
 
 const SDL_Color &TextBox::get_text_color() const { return color; }
 
 void TextBox::set_font_size(const int new_font_size) {
     font_size = new_font_size;
-    generate_texture();
+    generate_layout();
 }
 
 const std::string &TextBox::get_text() const { return text; }
@@ -120,15 +114,27 @@ void TextBox::render(const int x_offset, const int y_offset,
     if (text.empty()) {
         return;
     }
-    // When rendering text, set logical size to the size of the window to allow
-    // better quality text. Because of this, need to manually adjust for DPI.
-    SDL_RenderSetLogicalSize(gRenderer, dpi_ratio * window_state.screen_width,
-                             dpi_ratio * window_state.screen_height);
-    texture.render_corner(
-        static_cast<int>(dpi_ratio * (x_offset + x + text_offset_x)),
+    if (atlas_generation != gGlyphAtlas.get_generation()) {
+        generate_layout();
+    }
+    // Text is drawn with the logical size set to the size of the window to
+    // allow better quality text. Because of this, need to manually adjust for DPI.
+    auto px = static_cast<float>(
+        static_cast<int>(dpi_ratio * (x_offset + x + text_offset_x)));
+    auto py = static_cast<float>(
         static_cast<int>(dpi_ratio * (y_offset + y + text_offset_y)));
-    SDL_RenderSetLogicalSize(gRenderer, window_state.screen_width,
-                             window_state.screen_height);
+    if (px != placed_x || py != placed_y) {
+        for (auto &v : verticies) {
+            v.position.x += px - placed_x;
+            v.position.y += py - placed_y;
+        }
+        placed_x = px;
+        placed_y = py;
+    }
+    // Drawn right away, unless an enclosing text pass is active.
+    gTextPass.begin();
+    gTextPass.add(verticies, indices, dpi_ratio, window_state);
+    gTextPass.end();
 }
 
 Polygon::Polygon(std::initializer_list<SDL_FPoint> points) {
@@ -148,7 +154,7 @@ void Polygon::render(int x_offset, int y_offset) const {
         }
         me->x_offset = x_offset;
     }
-    if (x_offset != me->y_offset) {
+    if (y_offset != me->y_offset) {
         for (auto& v: me->verticies) {
             v.position.y = v.position.y - me->y_offset + y_offset;
         }
@@ -158,6 +164,20 @@ void Polygon::render(int x_offset, int y_offset) const {
                        verticies.size(), nullptr, 0);
 }
 
+void Polygon::append_geometry(int x_offset, int y_offset,
+                              std::vector<SDL_Vertex> &out,
+                              std::vector<int> &indices) const {
+    int base = static_cast<int>(out.size());
+    float dx = static_cast<float>(x_offset - this->x_offset);
+    float dy = static_cast<float>(y_offset - this->y_offset);
+    for (const auto &v : verticies) {
+        out.push_back({{v.position.x + dx, v.position.y + dy}, v.color, v.tex_coord});
+    }
+    for (int i = 0; i < static_cast<int>(verticies.size()); ++i) {
+        indices.push_back(base + i);
+    }
+}
+
 void Polygon::set_points(std::initializer_list<SDL_FPoint> points) {
     verticies.clear();
     for (auto p : points) {
@@ -201,6 +221,34 @@ void Box::render(int x_offset, int y_offset) const {
     SDL_RenderFillRect(gRenderer, &r);
 }
 
+namespace {
+
+void append_rect(const SDL_Rect &r, SDL_Color color, std::vector<SDL_Vertex> &out,
+                 std::vector<int> &indices) {
+    int base = static_cast<int>(out.size());
+    float x0 = static_cast<float>(r.x), y0 = static_cast<float>(r.y);
+    float x1 = x0 + r.w, y1 = y0 + r.h;
+    out.push_back({{x0, y0}, color, {0.0f, 0.0f}});
+    out.push_back({{x1, y0}, color, {0.0f, 0.0f}});
+    out.push_back({{x1, y1}, color, {0.0f, 0.0f}});
+    out.push_back({{x0, y1}, color, {0.0f, 0.0f}});
+    indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+}
+
+}
+
+void Box::append_geometry(int x_offset, int y_offset, std::vector<SDL_Vertex> &out,
+                          std::vector<int> &indices) const {
+    SDL_Rect outer = {rect.x + x_offset, rect.y + y_offset, rect.w, rect.h};
+    append_rect(outer, {r, g, b, a}, out, indices);
+    if (filled) {
+        return;
+    }
+    SDL_Rect inner = {outer.x + border_width, outer.y + border_width,
+                      outer.w - 2 * border_width, outer.h - 2 * border_width};
+    append_rect(inner, {UI_BACKGROUND_COLOR}, out, indices);
+}
+
 void Box::set_border_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     this->r = r;
     this->g = g;
@@ -474,3 +522,78 @@ void Dropdown::set_text_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
         btn.text.set_text_color(r, g, b, a);
     }
 }
+
+void Components::render_geometry(int x_offset, int y_offset) const {
+    if (geometry_dirty || x_offset != geometry_x || y_offset != geometry_y) {
+        geometry.clear();
+        geometry_indices.clear();
+        for (auto &border : std::get<0>(comps)) {
+            border.append_geometry(x_offset, y_offset, geometry, geometry_indices);
+        }
+        for (auto &polygon : std::get<1>(comps)) {
+            polygon.append_geometry(x_offset, y_offset, geometry, geometry_indices);
+        }
+        geometry_dirty = false;
+        geometry_x = x_offset;
+        geometry_y = y_offset;
+    }
+    if (geometry_indices.empty()) {
+        return;
+    }
+    SDL_RenderGeometry(gRenderer, nullptr, geometry.data(),
+                       static_cast<int>(geometry.size()), geometry_indices.data(),
+                       static_cast<int>(geometry_indices.size()));
+}
+
+bool Components::render_cached(int x_offset, int y_offset) const {
+    if (!SDL_RenderTargetSupported(gRenderer)) {
+        return false;
+    }
+    double dpi = std::min(
+        static_cast<double>(window_state->window_width) / window_state->screen_width,
+        static_cast<double>(window_state->window_height) / window_state->screen_height);
+    int w = static_cast<int>(window_state->screen_width * dpi);
+    int h = static_cast<int>(window_state->screen_height * dpi);
+    int cache_w = 0, cache_h = 0;
+    if (cache != nullptr) {
+        SDL_QueryTexture(cache.get(), nullptr, nullptr, &cache_w, &cache_h);
+    }
+    if (cache_w != w || cache_h != h) {
+        cache.reset(SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888,
+                                      SDL_TEXTUREACCESS_TARGET, w, h));
+        if (cache == nullptr) {
+            LOG_WARNING_CAT(LogCategory::ENGINE, "Failed creating component cache: %s",
+                            SDL_GetError());
+            return false;
+        }
+        // Rendering onto a transparent target leaves premultiplied colors.
+        SDL_SetTextureBlendMode(
+            cache.get(), SDL_ComposeCustomBlendMode(
+                             SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                             SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE,
+                             SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD));
+        dirty = true;
+    }
+    if (dirty || x_offset != cache_x || y_offset != cache_y ||
+        cache_generation != gGlyphAtlas.get_generation()) {
+        if (SDL_SetRenderTarget(gRenderer, cache.get()) != 0) {
+            cache.reset();
+            return false;
+        }
+        float scale = static_cast<float>(dpi);
+        SDL_RenderSetScale(gRenderer, scale, scale);
+        Uint8 r, g, b, a;
+        SDL_GetRenderDrawColor(gRenderer, &r, &g, &b, &a);
+        SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 0);
+        SDL_RenderClear(gRenderer);
+        SDL_SetRenderDrawColor(gRenderer, r, g, b, a);
+        render_direct(x_offset, y_offset);
+        SDL_SetRenderTarget(gRenderer, nullptr);
+        cache_x = x_offset;
+        cache_y = y_offset;
+        cache_generation = gGlyphAtlas.get_generation();
+    }
+    SDL_Rect dst{0, 0, window_state->screen_width, window_state->screen_height};
+    SDL_RenderCopy(gRenderer, cache.get(), nullptr, &dst);
+    return true;
+}
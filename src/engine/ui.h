@@ -3,10 +3,13 @@
 #include "game.h"
 #include "engine.h"
 #include "texture.h"
+#include "glyph_atlas.h"
+#include "text_pass.h"
 #include "log.h"
 #include <SDL_ttf.h>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -33,6 +36,12 @@ public:
      */
     void set_text(const std::string &text);
 
+    /**
+     * Sets the text of the textbox, with a color per character.
+     * Characters past the end of colors use the text color.
+     */
+    void set_text(const std::string &text, std::vector<SDL_Color> colors);
+
     /**
      * Sets the font size of the textbox.
      */
@@ -89,26 +98,41 @@ protected:
 
     int font_size{};
 
-    int text_offset_x{};
+    // Derived from the layout, which render may redo.
+    mutable int text_offset_x{};
 
-    int text_offset_y{};
+    mutable int text_offset_y{};
 
     std::string text;
 
     double dpi_ratio{};
 
 private:
-    Texture texture;
+    // Glyph quads from gGlyphAtlas, positioned at (placed_x, placed_y).
+    // Cached layout, redone and moved by render as needed.
+    mutable std::vector<SDL_Vertex> verticies{};
+    mutable std::vector<int> indices{};
+    mutable float placed_x = 0.0f, placed_y = 0.0f;
+
+    // Size of the laid out text, in font pixels.
+    mutable int text_w = 0, text_h = 0;
+
+    mutable Uint32 atlas_generation = 0;
 
     SDL_Color color = {0, 0, 0, 0};
+    // Per character colors, empty if all use color.
+    std::vector<SDL_Color> char_colors{};
 
     Alignment alignment = Alignment::CENTRE;
 
     /**
-     * Generates the texture containing the text of the button. Called by
-     * constructor and set_text.
+     * Lays out the text as glyph quads and updates the text offsets.
+     * Does not create any textures. Called by constructor and set_text.
      */
-    void generate_texture();
+    void generate_layout() const;
+
+    // Sets text_offset_x and text_offset_y from the alignment and text size.
+    void update_offsets() const;
 
     static TTF_Font *font;
 };
@@ -121,6 +145,14 @@ public:
 
     void render(int x_offset, int y_offset) const;
 
+    /**
+     * Appends the triangles of the polygon to verticies and indices, for
+     * drawing many shapes with a single SDL_RenderGeometry call.
+     */
+    void append_geometry(int x_offset, int y_offset,
+                         std::vector<SDL_Vertex> &verticies,
+                         std::vector<int> &indices) const;
+
     void set_points(std::initializer_list<SDL_FPoint> points);
 
     void set_border_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
@@ -144,6 +176,14 @@ public:
 
     void render(int x_offset, int y_offset) const;
 
+    /**
+     * Appends the box as triangles to verticies and indices, same as
+     * Polygon::append_geometry.
+     */
+    void append_geometry(int x_offset, int y_offset,
+                         std::vector<SDL_Vertex> &verticies,
+                         std::vector<int> &indices) const;
+
     void set_border_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
 private:
@@ -284,6 +324,11 @@ public:
     C& operator*();
 
     C* operator->();
+
+    // Read only access, does not mark the components as changed.
+    const C& operator*() const;
+
+    const C* operator->() const;
 private:
     Component(Components* comps, std::size_t ix) : comps{comps}, ix(ix) {}
 
@@ -307,6 +352,10 @@ class Components {
 
     std::vector<CallbackData> callbacks {};
 
+    // Components drawn by render_geometry.
+    template <class C>
+    static constexpr bool is_geometry = std::is_same_v<C, Box> || std::is_same_v<C, Polygon>;
+
 public:
     Components() {
         auto cb = [](int64_t, void*) {};
@@ -321,6 +370,24 @@ public:
         std::get<3>(comps).clear();
         std::get<4>(comps).clear();
         callbacks.resize(1);
+        dirty = true;
+        geometry_dirty = true;
+    }
+
+    /**
+     * Returns true if anything was changed since the last render.
+     * Accessing a component through its Component handle counts as a change.
+     */
+    bool is_dirty() const { return dirty; }
+
+    /**
+     * If cached, the components are drawn into a texture which is reused
+     * until something changes. Meant for static content, like borders and
+     * labels. Buttons still react to presses, but hovering is not shown.
+     */
+    void set_cached(bool cached) {
+        this->cached = cached;
+        dirty = true;
     }
 
     void set_window_state(WindowState* window_state) {
@@ -328,6 +395,7 @@ public:
     }
 
     void enable_hover(bool enabled) {
+        dirty = true;
         for (auto& btn: std::get<std::vector<Button>>(comps)) {
             btn.enable_hover(enabled);
         }
@@ -337,6 +405,7 @@ public:
     }
 
     void set_dpi(double dpi_scale) {
+        dirty = true;
         for (auto &text: std::get<2>(comps)) {
             text.set_dpi_ratio(dpi_scale);
         }
@@ -349,21 +418,10 @@ public:
     }
 
     void render(int x_offset, int y_offset) const {
-        for (auto &border: std::get<0>(comps)) {
-            border.render(x_offset, y_offset);
-        }
-        for (auto &polygon: std::get<1>(comps)) {
-            polygon.render(x_offset, y_offset);
-        }
-        for (auto &text: std::get<2>(comps)) {
-            text.render(x_offset, y_offset, *window_state);
-        }
-        for (auto &btn: std::get<3>(comps)) {
-            btn.render(x_offset, y_offset, *window_state);
-        }
-        for (auto &dropdown : std::get<4>(comps)) {
-            dropdown.render(x_offset, y_offset, *window_state);
+        if (cached && render_cached(x_offset, y_offset)) {
+            return;
         }
+        render_direct(x_offset, y_offset);
     }
 
     void handle_press(int x_offset, int y_offset, bool press) {
@@ -381,6 +439,7 @@ public:
                 val = dropdown.get_choice();
             }
         }
+        dirty = true;
         if (ix != 0) {
             // Delay callback until after iteration, in case callback changes
             // this. Currently only allows one callback per press.
@@ -392,6 +451,8 @@ public:
     Component<C> add(C&& comp) {
         auto& vec = std::get<std::vector<C>>(comps);
         vec.push_back(std::move(comp));
+        dirty = true;
+        geometry_dirty |= is_geometry<C>;
         return {this, vec.size() - 1};
     }
 
@@ -399,6 +460,8 @@ public:
     Component<C> add(C&& comp, void(*cb)(Args...), Args... args) {
         auto& vec = std::get<std::vector<C>>(comps);
         vec.push_back(std::move(comp));
+        dirty = true;
+        geometry_dirty |= is_geometry<C>;
 
         struct Wrapper : public WrapperBase {
             explicit Wrapper(Args... args, void(*cb)(Args...))
@@ -423,6 +486,8 @@ public:
     Component<C> add(C&& comp, void(*cb)(int64_t data, Args...), Args... args) {
         auto& vec = std::get<std::vector<C>>(comps);
         vec.push_back(std::move(comp));
+        dirty = true;
+        geometry_dirty |= is_geometry<C>;
 
         struct Wrapper : public WrapperBase {
             explicit Wrapper(Args... args, void(*cb)(int64_t data, Args...))
@@ -444,20 +509,72 @@ public:
     }
 
 private:
+    void render_direct(int x_offset, int y_offset) const {
+        dirty = false;
+        render_geometry(x_offset, y_offset);
+        // Text boxes and buttons are not expected to overlap, so all their
+        // text can be drawn together. Dropdown lists can cover other text.
+        gTextPass.begin();
+        for (auto &text: std::get<2>(comps)) {
+            text.render(x_offset, y_offset, *window_state);
+        }
+        for (auto &btn: std::get<3>(comps)) {
+            btn.render(x_offset, y_offset, *window_state);
+        }
+        gTextPass.end();
+        for (auto &dropdown : std::get<4>(comps)) {
+            dropdown.render(x_offset, y_offset, *window_state);
+        }
+    }
+
+    // Draws all boxes and polygons with one SDL_RenderGeometry call.
+    void render_geometry(int x_offset, int y_offset) const;
+
+    // Renders through the cache texture. Returns false if render targets
+    // are not available.
+    bool render_cached(int x_offset, int y_offset) const;
+
     WindowState* window_state = nullptr;
 
     std::tuple<std::vector<Box>, std::vector<Polygon>, std::vector<TextBox>, std::vector<Button>,
                std::vector<Dropdown>>
         comps{};
+
+    mutable bool dirty = true;
+
+    // Triangles of all boxes and polygons, rebuilt when one of them changes.
+    mutable std::vector<SDL_Vertex> geometry{};
+    mutable std::vector<int> geometry_indices{};
+    mutable bool geometry_dirty = true;
+    mutable int geometry_x = 0, geometry_y = 0;
+
+    bool cached = false;
+    mutable std::unique_ptr<SDL_Texture, TextureDeleter> cache{};
+    mutable int cache_x = 0, cache_y = 0;
+    mutable Uint32 cache_generation = 0;
 };
 
 template<class C>
 C& Component<C>::operator*() {
+    comps->dirty = true;
+    comps->geometry_dirty |= Components::is_geometry<C>;
     return std::get<std::vector<C>>(comps->comps)[ix];
 }
 
 template<class C>
 C* Component<C>::operator->() {
+    comps->dirty = true;
+    comps->geometry_dirty |= Components::is_geometry<C>;
+    return &std::get<std::vector<C>>(comps->comps)[ix];
+}
+
+template<class C>
+const C& Component<C>::operator*() const {
+    return std::get<std::vector<C>>(comps->comps)[ix];
+}
+
+template<class C>
+const C* Component<C>::operator->() const {
     return &std::get<std::vector<C>>(comps->comps)[ix];
 }
 
@@ -0,0 +1,172 @@
+#include "headless.h"
+#include "engine/log.h"
+#include "problem.h"
+#include "program_object.h"
+#include "simulation.h"
+#include <SDL.h>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Parses a whole argument as a decimal count. strtoull alone accepts
+// signs, leading spaces and trailing garbage.
+bool parse_count(const char* s, uint64_t& out) {
+    if (*s < '0' || *s > '9') {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    unsigned long long val = std::strtoull(s, &end, 10);
+    if (errno == ERANGE || *end != '\0') {
+        return false;
+    }
+    out = val;
+    return true;
+}
+
+bool read_lines(const char* path, std::vector<std::string>& lines) {
+    SDL_RWops* file = SDL_RWFromFile(path, "r");
+    if (file == nullptr) {
+        LOG_CRITICAL("Failed opening '%s': %s", path, SDL_GetError());
+        return false;
+    }
+    Sint64 size = SDL_RWsize(file);
+    std::string str;
+    str.resize(size < 0 ? 0 : static_cast<std::size_t>(size));
+    bool ok = size >= 0 && SDL_RWread(file, &str[0], 1, str.size()) == str.size();
+    SDL_RWclose(file);
+    if (!ok) {
+        LOG_CRITICAL("Failed reading '%s'", path);
+        return false;
+    }
+    if (!str.empty() && str.back() == '\n') {
+        str.pop_back();
+    }
+    lines.clear();
+    std::size_t start = 0;
+    while (true) {
+        std::size_t end = str.find('\n', start);
+        std::size_t len = (end == std::string::npos ? str.size() : end) - start;
+        lines.emplace_back(str, start, len);
+        if (!lines.back().empty() && lines.back().back() == '\r') {
+            lines.back().pop_back();
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+int compile(int argc, char* argv[], const std::vector<ProcessorTemplate>& templates) {
+    if (argc < 4) {
+        LOG_CRITICAL("Usage: --compile <source> <object> [template]");
+        return 1;
+    }
+    uint64_t ix = 0;
+    if (argc > 4 && !parse_count(argv[4], ix)) {
+        LOG_CRITICAL("Invalid template index '%s'", argv[4]);
+        return 1;
+    }
+    if (ix >= templates.size()) {
+        LOG_CRITICAL("No template with index %llu", static_cast<unsigned long long>(ix));
+        return 1;
+    }
+    auto lines = std::make_shared<std::vector<std::string>>();
+    if (!read_lines(argv[2], *lines)) {
+        return 1;
+    }
+    const ProcessorTemplate& temp = templates[ix];
+    Processor processor = temp.instantiate();
+    CompileJob job = processor.create_compile_job(lines);
+    CompileResult res = run_compile_job(job);
+    if (!res.valid) {
+        for (auto& err : res.errors) {
+            LOG_CRITICAL("%s:%llu:%llu: %s", argv[2],
+                         static_cast<unsigned long long>(err.pos.row + 1),
+                         static_cast<unsigned long long>(err.pos.col + 1),
+                         err.msg.c_str());
+        }
+        return 1;
+    }
+    try {
+        write_program_object(argv[3], res.instructions,
+                             static_cast<uint32_t>(lines->size()), temp.fingerprint());
+    } catch (program_object_exception& e) {
+        LOG_CRITICAL("%s", e.msg.c_str());
+        return 1;
+    }
+    LOG_INFO("Wrote %llu instructions for '%s'",
+             static_cast<unsigned long long>(res.instructions.size()), temp.name.c_str());
+    return 0;
+}
+
+int run(int argc, char* argv[], const std::vector<ProcessorTemplate>& templates) {
+    if (argc < 4) {
+        LOG_CRITICAL("Usage: --run <object> <ticks>");
+        return 1;
+    }
+    uint64_t ticks;
+    if (!parse_count(argv[3], ticks)) {
+        LOG_CRITICAL("Invalid tick count '%s'", argv[3]);
+        return 1;
+    }
+    ProgramObject object;
+    try {
+        object = ProgramObject{argv[2]};
+    } catch (program_object_exception& e) {
+        LOG_CRITICAL("%s", e.msg.c_str());
+        return 1;
+    }
+    const ProcessorTemplate* temp = nullptr;
+    for (auto& t : templates) {
+        if (t.fingerprint() == object.fingerprint()) {
+            temp = &t;
+            break;
+        }
+    }
+    if (temp == nullptr) {
+        LOG_CRITICAL("No template matches '%s'", argv[2]);
+        return 1;
+    }
+
+    Processor processor = temp->instantiate();
+    if (!processor.load_program(object)) {
+        return 1;
+    }
+    ByteProblem problem{};
+    problem.reset();
+    processor.start();
+    for (uint64_t i = 0; i < ticks; ++i) {
+        tick_simulation(processor, problem);
+    }
+
+    const RegisterFile& registers = processor.get_registers();
+    std::printf("template: %s\n", temp->name.c_str());
+    std::printf("ticks: %llu\n", static_cast<unsigned long long>(processor.get_ticks()));
+    std::printf("pc: %u\n", processor.get_pc());
+    for (uint64_t i = 0; i < registers.count_genreg(); ++i) {
+        std::printf("%s: %llu\n", registers.to_name_genreg(i).c_str(),
+                    static_cast<unsigned long long>(registers.get_genreg(i)));
+    }
+    std::printf("flags: %u\n", registers.flags);
+    return 0;
+}
+
+} // namespace
+
+bool is_headless(int argc, char* argv[]) {
+    return argc > 1 && (std::strcmp(argv[1], "--compile") == 0 ||
+                        std::strcmp(argv[1], "--run") == 0);
+}
+
+int run_headless(int argc, char* argv[], const std::vector<ProcessorTemplate>& templates) {
+    if (std::strcmp(argv[1], "--compile") == 0) {
+        return compile(argc, argv, templates);
+    }
+    return run(argc, argv, templates);
+}
@@ -0,0 +1,26 @@
+#ifndef PROC_ASM_HEADLESS_H
+#define PROC_ASM_HEADLESS_H
+#include "processor.h"
+#include <vector>
+
+/**
+ * Returns true if the arguments select a headless command, meaning no
+ * window should be created.
+ */
+bool is_headless(int argc, char* argv[]);
+
+/**
+ * Runs a command without any graphics.
+ *
+ *   --compile <source> <object> [template]
+ *      Compiles source for the template with the given index (default 0)
+ *      into a program object.
+ *   --run <object> <ticks>
+ *      Runs a program object for a number of ticks on the template it was
+ *      compiled for and prints the final processor state.
+ *
+ * @return the exit code of the program.
+ */
+int run_headless(int argc, char* argv[], const std::vector<ProcessorTemplate>& templates);
+
+#endif
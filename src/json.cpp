@@ -1,90 +1,42 @@
 #include "json.h"
 #include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <sstream>
 #include <climits>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+#include <vector>
 
-namespace json {
-    Type::Type() : type{JSON_NULL} {}
-
-    Type::Type(const Type& other) : type{JSON_NULL} {
-        *this = other;
-    }
-
-    Type& Type::operator=(const Type& other) {
-        if (this == &other) {
-            return *this;
-        }
-        free();
-        type = other.type;
-        switch(other.type) {
-            case OBJECT:
-                object = new JsonObject(*other.object);
-                break;
-            case LIST:
-                list = new JsonList(*other.list);
-                break;
-            case INTEGER:
-                integer = other.integer;
-                break;
-            case DOUBLE:
-                decimal = other.decimal;
-                break;
-            case BOOL:
-                boolean = other.boolean;
-                break;
-            case STRING:
-                str = new std::string(*other.str);
-                break;
-            case JSON_NULL:
-                break;
-        }
-        return *this;
-    }
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
-    Type::Type(Type&& other) : type{JSON_NULL} {
-        *this = std::move(other);
-    }
-
-    Type& Type::operator=(Type&& other) {
-        if (this == &other) {
-            return *this;
-        }
-        free();
-        type = other.type;
-        other.type = JSON_NULL;
-        switch(type) {
-            case OBJECT:
-                object = other.object;
-                other.object = nullptr;
-                break;
-            case LIST:
-                list = other.list;
-                other.list = nullptr;
-                break;
-            case INTEGER:
-                integer = other.integer;
-                break;
-            case DOUBLE:
-                decimal = other.decimal;
-                break;
-            case BOOL:
-                boolean = other.boolean;
-                break;
-            case STRING:
-                str = other.str;
-                other.str = nullptr;
-                break;
-            case JSON_NULL:
-                break;
-        }
-        return *this;
-    }
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_SSE2
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+inline unsigned count_trailing_zeros(unsigned mask) {
+    unsigned long ix;
+    _BitScanForward(&ix, mask);
+    return ix;
+}
+#else
+inline unsigned count_trailing_zeros(unsigned mask) { return __builtin_ctz(mask); }
+#endif
+#endif
 
-    Type::~Type() {
-        free();
-        type = JSON_NULL;
-    }
+namespace json {
     template <> const JsonObject *Type::get() const {
         if (type == OBJECT) {
             return object;
@@ -115,61 +67,127 @@ namespace json {
         }
         return nullptr;
     }
-    template <> const std::string* Type::get() const {
+    template <> const std::string_view* Type::get() const {
         if (type == STRING) {
-            return str;
+            return &str;
         }
         return nullptr;
     }
-    template <> void Type::set(JsonObject obj) {
-        free();
-        type = OBJECT;
-        object = new JsonObject(std::move(obj));
-    }
-    template <> void Type::set(JsonList jlist) {
-        free();
-        type = LIST;
-        list = new JsonList(std::move(jlist));
-    }
-    template <> void Type::set(int64_t i) {
-        free();
-        type = INTEGER;
-        integer = i;
-    }
-    template <> void Type::set(double d) {
-        free();
-        type = DOUBLE;
-        decimal = d;
-    }
-    template <> void Type::set(bool b) {
-        free();
-        type = BOOL;
-        boolean = b;
-    }
-    template <> void Type::set(std::string s) {
-        free();
-        type = STRING;
-        str = new std::string(std::move(s));
-    }
-    template <> void Type::set(std::nullptr_t n) {
-        free();
-        type = JSON_NULL;
-    }
-
-    void Type::free() {
-        switch (type) {
-        case OBJECT:
-            delete object;
-            break;
-        case STRING: 
-            delete str;
-            break;
-        case LIST:
-            delete list;
-            break;
-        default:
-            break;
+
+    Type Type::make_object(const JsonObject *obj) {
+        Type t;
+        t.type = OBJECT;
+        t.object = obj;
+        return t;
+    }
+    Type Type::make_list(const JsonList *list) {
+        Type t;
+        t.type = LIST;
+        t.list = list;
+        return t;
+    }
+    Type Type::make_integer(int64_t i) {
+        Type t;
+        t.type = INTEGER;
+        t.integer = i;
+        return t;
+    }
+    Type Type::make_decimal(double d) {
+        Type t;
+        t.type = DOUBLE;
+        t.decimal = d;
+        return t;
+    }
+    Type Type::make_bool(bool b) {
+        Type t;
+        t.type = BOOL;
+        t.boolean = b;
+        return t;
+    }
+    Type Type::make_string(std::string_view s) {
+        Type t;
+        t.type = STRING;
+        new (&t.str) std::string_view{s};
+        return t;
+    }
+
+    Arena::Arena(std::size_t block_size) : block_size{block_size} {}
+
+    Arena::~Arena() {
+        while (head != nullptr) {
+            Block *prev = head->prev;
+            ::operator delete(head);
+            head = prev;
+        }
+    }
+
+    void *Arena::allocate(std::size_t size, std::size_t align) {
+        if (head != nullptr) {
+            auto base = reinterpret_cast<uintptr_t>(head + 1);
+            uintptr_t ptr = (base + head->used + align - 1) & ~(align - 1);
+            if (ptr + size <= base + head->size) {
+                head->used = ptr + size - base;
+                return reinterpret_cast<void *>(ptr);
+            }
+        }
+        // Oversized allocations get a block of their own.
+        std::size_t new_size = std::max(block_size, size + align);
+        auto *block = static_cast<Block *>(::operator new(sizeof(Block) + new_size));
+        block->prev = head;
+        block->size = new_size;
+        block->used = 0;
+        head = block;
+        return allocate(size, align);
+    }
+
+    std::string_view Arena::copy_string(std::string_view s) {
+        if (s.empty()) {
+            return {};
+        }
+        char *data = static_cast<char *>(allocate(s.size(), 1));
+        std::memcpy(data, s.data(), s.size());
+        return {data, s.size()};
+    }
+
+    void Arena::reset() {
+        Block *largest = nullptr;
+        while (head != nullptr) {
+            Block *prev = head->prev;
+            if (largest == nullptr || head->size > largest->size) {
+                if (largest != nullptr) {
+                    ::operator delete(largest);
+                }
+                largest = head;
+            } else {
+                ::operator delete(head);
+            }
+            head = prev;
         }
+        head = largest;
+        if (head != nullptr) {
+            head->prev = nullptr;
+            head->used = 0;
+        }
+    }
+
+    std::size_t Arena::capacity() const {
+        std::size_t total = 0;
+        for (Block *b = head; b != nullptr; b = b->prev) {
+            total += b->size;
+        }
+        return total;
+    }
+
+    const JsonObject EMPTY_OBJECT{};
+
+    Document::Document() : arena{std::make_unique<Arena>()}, root_obj{&EMPTY_OBJECT} {}
+
+    json_exception missing_key(std::string_view key) {
+        return json_exception("Missing key '" + std::string(key) + "'");
+    }
+
+    json_exception wrong_type(std::string_view key) {
+        return json_exception("Wrong type for '" + std::string(key) + "'");
     }
 }
 
@@ -218,19 +236,21 @@ void skip_spacing(std::size_t &ix, const std::string &in);
 
 void validate_char(std::size_t ix, const std::string &in, char c);
 
-JsonObject read_object(std::size_t &ix, const std::string &in);
+void read_object(std::size_t &ix, const std::string &in, json::Handler &handler,
+                 std::string &buf);
+
+void read_list(std::size_t &ix, const std::string &in, json::Handler &handler,
+               std::string &buf);
 
-JsonList read_list(std::size_t &ix, const std::string &in);
+void read_value(std::size_t &ix, const std::string &in, json::Handler &handler,
+                std::string &buf);
 
 void read_matching(std::size_t &ix, const std::string &in, const std::string &s);
 
 bool read_number(std::size_t &ix, const std::string &in, int64_t &i_val,
                  double &d_val);
 
-void to_pretty_stream(std::ostream &os, const json::Type &val,
-                      int indentations);
-
-std::string read_string(std::size_t &ix, const std::string &in);
+void read_string(std::size_t &ix, const std::string &in, std::string &res);
 
 void read_matching(std::size_t &ix, const std::string &in, const std::string &s) {
     if (ix >= in.size()) {
@@ -359,84 +379,91 @@ bool read_number(std::size_t &ix, const std::string &in, int64_t &i_val,
     }
 }
 
-JsonObject read_object(std::size_t &ix, const std::string &in) {
+void read_value(std::size_t &ix, const std::string &in, json::Handler &handler,
+                std::string &buf) {
+    switch (in[ix]) {
+    case '"': {
+        read_string(ix, in, buf);
+        handler.string(buf);
+        break;
+    }
+    case '{': {
+        read_object(ix, in, handler, buf);
+        break;
+    }
+    case '[': {
+        read_list(ix, in, handler, buf);
+        break;
+    }
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9': {
+        int64_t i_val;
+        double d_val;
+        if (read_number(ix, in, i_val, d_val)) {
+            handler.integer(i_val);
+        } else {
+            handler.decimal(d_val);
+        }
+        break;
+    }
+    case 'n': {
+        read_matching(ix, in, "null");
+        handler.null();
+        break;
+    }
+    case 't': {
+        read_matching(ix, in, "true");
+        handler.boolean(true);
+        break;
+    }
+    case 'f': {
+        read_matching(ix, in, "false");
+        handler.boolean(false);
+        break;
+    }
+    default:
+        throw unexpected_char(ix, in, in[ix]);
+    }
+}
+
+void read_object(std::size_t &ix, const std::string &in, json::Handler &handler,
+                 std::string &buf) {
     validate_char(ix, in, '{');
-    JsonObject obj;
+    handler.start_object();
     skip_spacing(ix, in);
     if (ix >= in.size()) {
         throw end_of_data();
     }
     if (in[ix] == '}') {
-        return obj;
+        handler.end_object();
+        return;
     }
     while (true) {
-        std::string key = read_string(ix, in);
+        read_string(ix, in, buf);
+        handler.key(buf);
         skip_spacing(ix, in);
         validate_char(ix, in, ':');
         skip_spacing(ix, in);
         if (ix >= in.size()) {
             throw end_of_data();
         }
-        switch (in[ix]) {
-        case '"': {
-            std::string val = read_string(ix, in);
-            obj.set(key, val);
-            break;
-        }
-        case '{': {
-            JsonObject val = read_object(ix, in);
-            obj.set(key, val);
-            break;
-        }
-        case '[': {
-            JsonList val = read_list(ix, in);
-            obj.set(key, val);
-            break;
-        }
-        case '-':
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9': {
-            int64_t i_val;
-            double d_val;
-            if (read_number(ix, in, i_val, d_val)) {
-                obj.set(key, i_val);
-            } else {
-                obj.set(key, d_val);
-            }
-            break;
-        }
-        case 'n': {
-            read_matching(ix, in, "null");
-            obj.set<std::nullptr_t>(key, nullptr);
-            break;
-        }
-        case 't': {
-            read_matching(ix, in, "true");
-            obj.set<bool>(key, true);
-            break;
-        }
-        case 'f': {
-            read_matching(ix, in, "false");
-            obj.set<bool>(key, false);
-            break;
-        }
-        default:
-            throw unexpected_char(ix, in, in[ix]);
-        }
+        read_value(ix, in, handler, buf);
         skip_spacing(ix, in);
         if (ix >= in.size()) {
             throw end_of_data();
         }
         if (in[ix] == '}') {
-            return obj;
+            handler.end_object();
+            return;
         }
         if (in[ix] != ',') {
             throw unexpected_char(ix, in, in[ix]);
@@ -445,78 +472,27 @@ JsonObject read_object(std::size_t &ix, const std::string &in) {
     }
 }
 
-JsonList read_list(std::size_t& ix, const std::string& in) {
+void read_list(std::size_t &ix, const std::string &in, json::Handler &handler,
+               std::string &buf) {
     validate_char(ix, in, '[');
-    JsonList list;
+    handler.start_list();
     skip_spacing(ix, in);
     if (ix >= in.size()) {
         throw end_of_data();
     }
     if (in[ix] == ']') {
-        return list;
+        handler.end_list();
+        return;
     }
     while (true) {
-        switch (in[ix]) {
-        case '"': {
-            std::string val = read_string(ix, in);
-            list.push_back(val);
-            break;
-        }
-        case '{': {
-            JsonObject val = read_object(ix, in);
-            list.push_back(val);
-            break;
-        }
-        case '[': {
-            JsonList val = read_list(ix, in);
-            list.push_back(val);
-            break;
-        }
-        case '-':
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9': {
-            int64_t i_val;
-            double d_val;
-            if (read_number(ix, in, i_val, d_val)) {
-                list.push_back(i_val);
-            } else {
-                list.push_back(d_val);
-            }
-            break;
-        }
-        case 'n': {
-            read_matching(ix, in, "null");
-            list.push_back<std::nullptr_t>(nullptr);
-            break;
-        }
-        case 't': {
-            read_matching(ix, in, "true");
-            list.push_back<bool>(true);
-
-            break;
-        }
-        case 'f': {
-            read_matching(ix, in, "false");
-            list.push_back<bool>(false);
-            break;
-        }
-        default:
-            throw unexpected_char(ix, in, in[ix]);
-        }
+        read_value(ix, in, handler, buf);
         skip_spacing(ix, in);
         if (ix >= in.size()) {
             throw end_of_data();
         }
         if (in[ix] == ']') {
-            return list;
+            handler.end_list();
+            return;
         }
         else if (in[ix] != ',') {
             throw unexpected_char(ix, in, in[ix]);
@@ -528,10 +504,75 @@ JsonList read_list(std::size_t& ix, const std::string& in) {
     }
 }
 
-std::string read_string(std::size_t& ix, const std::string& in) {
+uint32_t read_hex4(std::size_t &ix, const std::string &in) {
+    uint32_t val = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (++ix >= in.size()) {
+            throw end_of_data();
+        }
+        char c = in[ix];
+        val <<= 4;
+        if (c >= '0' && c <= '9') {
+            val |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            val |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            val |= c - 'A' + 10;
+        } else {
+            throw unexpected_char(ix, in, c);
+        }
+    }
+    return val;
+}
+
+// Reads the digits of a \u escape, with ix at the 'u', and appends the
+// character as UTF-8. Surrogate pairs are combined, lone surrogates have no
+// UTF-8 form and become U+FFFD.
+void read_unicode_escape(std::size_t &ix, const std::string &in, std::string &res) {
+    uint32_t cp = read_hex4(ix, in);
+    if (cp >= 0xD800 && cp <= 0xDBFF && ix + 2 < in.size() &&
+        in[ix + 1] == '\\' && in[ix + 2] == 'u') {
+        std::size_t next = ix + 2;
+        uint32_t low = read_hex4(next, in);
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            ix = next;
+        }
+    }
+    if (cp >= 0xD800 && cp <= 0xDFFF) {
+        cp = 0xFFFD;
+    }
+    if (cp < 0x80) {
+        res.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        res.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        res.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        res.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        res.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+void read_string(std::size_t& ix, const std::string& in, std::string& res) {
     validate_char(ix, in, '"');
-    std::string res;
+    res.clear();
     while (++ix < in.size()) {
+        // Copy everything up to the next quote or escape in one go.
+        std::size_t end = ix;
+        while (end < in.size() && in[end] != '"' && in[end] != '\\') {
+            ++end;
+        }
+        res.append(in, ix, end - ix);
+        ix = end;
+        if (ix >= in.size()) {
+            break;
+        }
         if (in[ix] == '\\') {
             if (++ix >= in.size()) {
                 throw end_of_data();
@@ -548,14 +589,14 @@ std::string read_string(std::size_t& ix, const std::string& in) {
                 res.push_back('\f');
             } else if (in[ix] == 'r') {
                 res.push_back('\r');
+            } else if (in[ix] == 'u') {
+                read_unicode_escape(ix, in, res);
             } else {
                 throw json_exception("Unsupported escape character: \\" +
                                      std::string(1, in[ix]));
             }
-        } else if (in[ix] == '"') {
-            return res;
         } else {
-            res.push_back(in[ix]);
+            return;
         }
     }
     throw end_of_data();
@@ -568,196 +609,910 @@ void skip_spacing(std::size_t &ix, const std::string &in) {
                                 in[ix] == '\r' || in[ix] == '\t'));
 }
 
-JsonObject json::read_from_string(const std::string& in) {
-    std::size_t ix = 0;
-    if (in[0] != '{') {
-        skip_spacing(ix, in);
+namespace {
+
+/**
+ * Handler that builds a Document.
+ * Values of open objects and lists are collected on shared stacks, and
+ * copied into the arena as one flat array when the container ends.
+ */
+class DomBuilder : public json::Handler {
+public:
+    explicit DomBuilder(json::Arena &arena) : arena{arena} {}
+
+    void start_object() override {
+        frames.push_back({true, members.size(), next_key});
     }
-    return read_object(ix, in);
-}
 
-void json::to_pretty_stream(std::ostream &os, const json::Type &val) {
-    ::to_pretty_stream(os, val, 0);
-}
+    void key(std::string_view key) override { next_key = arena.copy_string(key); }
 
-void json::escape_string_to_stream(std::ostream &os, const std::string &s) {
-    os << '"';
-    for (char c : s) {
-        switch (c) {
-        case '\\':
-            os << "\\\\";
-            break;
-        case '\"':
-            os << "\\\"";
-            break;
-        case '\n':
-            os << "\\n";
+    void end_object() override {
+        Frame frame = frames.back();
+        frames.pop_back();
+        remove_duplicates(frame.start);
+        std::size_t count = members.size() - frame.start;
+        auto *data = arena.allocate_array<JsonObject::Member>(count);
+        std::uninitialized_copy(members.begin() + frame.start, members.end(), data);
+        members.resize(frame.start);
+        auto *obj = new (arena.allocate_array<JsonObject>(1)) JsonObject{data, count};
+        next_key = frame.key;
+        add(json::Type::make_object(obj));
+    }
+
+    void start_list() override {
+        frames.push_back({false, values.size(), next_key});
+    }
+
+    void end_list() override {
+        Frame frame = frames.back();
+        frames.pop_back();
+        std::size_t count = values.size() - frame.start;
+        auto *data = arena.allocate_array<json::Type>(count);
+        std::uninitialized_copy(values.begin() + frame.start, values.end(), data);
+        values.resize(frame.start);
+        auto *list = new (arena.allocate_array<JsonList>(1)) JsonList{data, count};
+        next_key = frame.key;
+        add(json::Type::make_list(list));
+    }
+
+    void string(std::string_view s) override {
+        add(json::Type::make_string(arena.copy_string(s)));
+    }
+
+    void integer(int64_t i) override { add(json::Type::make_integer(i)); }
+
+    void decimal(double d) override { add(json::Type::make_decimal(d)); }
+
+    void boolean(bool b) override { add(json::Type::make_bool(b)); }
+
+    void null() override { add(json::Type{}); }
+
+    const JsonObject *result() const { return root.get<JsonObject>(); }
+
+private:
+    struct Frame {
+        bool is_object;
+        std::size_t start;
+        // Key in the enclosing object, if there is one.
+        std::string_view key;
+    };
+
+    // Objects with more members than this use a hash map to find duplicates.
+    static constexpr std::size_t LINEAR_DUPLICATES = 16;
+
+    // Merges repeated keys of the object starting at start. A key keeps its
+    // first position and gets its last value, as if it was set twice.
+    void remove_duplicates(std::size_t start) {
+        std::size_t end = start;
+        if (members.size() - start <= LINEAR_DUPLICATES) {
+            for (std::size_t i = start; i < members.size(); ++i) {
+                std::size_t j = start;
+                while (j < end && members[j].first != members[i].first) {
+                    ++j;
+                }
+                if (j < end) {
+                    members[j].second = members[i].second;
+                } else {
+                    members[end++] = members[i];
+                }
+            }
+        } else {
+            std::unordered_map<std::string_view, std::size_t> seen;
+            seen.reserve(members.size() - start);
+            for (std::size_t i = start; i < members.size(); ++i) {
+                auto res = seen.emplace(members[i].first, end);
+                if (res.second) {
+                    members[end++] = members[i];
+                } else {
+                    members[res.first->second].second = members[i].second;
+                }
+            }
+        }
+        members.resize(end);
+    }
+
+    void add(json::Type val) {
+        if (frames.empty()) {
+            root = val;
+        } else if (frames.back().is_object) {
+            members.emplace_back(next_key, val);
+        } else {
+            values.push_back(val);
+        }
+    }
+
+    json::Arena &arena;
+
+    std::vector<Frame> frames;
+    std::vector<JsonObject::Member> members;
+    std::vector<json::Type> values;
+    std::string_view next_key;
+    json::Type root;
+};
+
+} // namespace
+
+// Inputs at least this large are parsed by StructuralParser.
+constexpr std::size_t STRUCTURAL_PARSE_THRESHOLD = 64 * 1024;
+
+namespace {
+
+/**
+ * Two stage parser for large inputs.
+ * Stage one classifies the input 64 bytes at a time into bitmasks of quotes,
+ * backslashes, structural characters and whitespace, and records the
+ * position of every token: structural characters and quotes outside of
+ * strings and the first character of every number or literal.
+ * Stage two walks that index and drives a Handler, only touching the bytes
+ * of numbers, literals and strings containing escapes.
+ */
+class StructuralParser {
+public:
+    StructuralParser(const std::string &in, json::Handler &handler)
+        : in{in}, handler{handler} {}
+
+    void parse() {
+        index();
+        std::size_t ix = next();
+        if (in[ix] != '{') {
+            throw expected_char(ix, in, '{');
+        }
+        read_object();
+    }
+
+private:
+    struct Masks {
+        uint64_t quote, backslash, structural, whitespace;
+    };
+
+    static void classify(const char *data, Masks &m) {
+#if defined(__AVX2__)
+        for (int i = 0; i < 2; ++i) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32 * i));
+            auto eq = [&v](char c) {
+                return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+            };
+            __m256i st = _mm256_or_si256(_mm256_or_si256(eq('{'), eq('}')),
+                                         _mm256_or_si256(eq('['), eq(']')));
+            st = _mm256_or_si256(st, _mm256_or_si256(eq(':'), eq(',')));
+            __m256i ws = _mm256_or_si256(_mm256_or_si256(eq(' '), eq('\n')),
+                                         _mm256_or_si256(eq('\r'), eq('\t')));
+            int shift = 32 * i;
+            m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(eq('"')))) << shift;
+            m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(eq('\\')))) << shift;
+            m.structural |= uint64_t(uint32_t(_mm256_movemask_epi8(st))) << shift;
+            m.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << shift;
+        }
+#elif defined(JSON_SSE2)
+        for (int i = 0; i < 4; ++i) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+            auto eq = [&v](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+            __m128i st = _mm_or_si128(_mm_or_si128(eq('{'), eq('}')),
+                                      _mm_or_si128(eq('['), eq(']')));
+            st = _mm_or_si128(st, _mm_or_si128(eq(':'), eq(',')));
+            __m128i ws = _mm_or_si128(_mm_or_si128(eq(' '), eq('\n')),
+                                      _mm_or_si128(eq('\r'), eq('\t')));
+            int shift = 16 * i;
+            m.quote |= uint64_t(_mm_movemask_epi8(eq('"'))) << shift;
+            m.backslash |= uint64_t(_mm_movemask_epi8(eq('\\'))) << shift;
+            m.structural |= uint64_t(_mm_movemask_epi8(st)) << shift;
+            m.whitespace |= uint64_t(_mm_movemask_epi8(ws)) << shift;
+        }
+#else
+        for (int i = 0; i < 64; ++i) {
+            uint64_t bit = uint64_t{1} << i;
+            switch (data[i]) {
+            case '"':
+                m.quote |= bit;
+                break;
+            case '\\':
+                m.backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                m.structural |= bit;
+                break;
+            case ' ':
+            case '\n':
+            case '\r':
+            case '\t':
+                m.whitespace |= bit;
+                break;
+            default:
+                break;
+            }
+        }
+#endif
+    }
+
+    // Bit i of the result is the xor of bits 0..i of x.
+    static uint64_t prefix_xor(uint64_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    static int ctz64(uint64_t x) {
+#ifdef _MSC_VER
+        unsigned long ix;
+        _BitScanForward64(&ix, x);
+        return static_cast<int>(ix);
+#else
+        return __builtin_ctzll(x);
+#endif
+    }
+
+    void index() {
+        tokens.clear();
+        tokens.reserve(in.size() / 8);
+        // State carried between blocks.
+        uint64_t escape_next = 0;
+        uint64_t in_string = 0;
+        uint64_t prev_scalar = 0;
+
+        char tail[64];
+        for (std::size_t block = 0; block < in.size(); block += 64) {
+            const char *data = in.data() + block;
+            if (in.size() - block < 64) {
+                std::memset(tail, ' ', sizeof(tail));
+                std::memcpy(tail, data, in.size() - block);
+                data = tail;
+            }
+            Masks m{0, 0, 0, 0};
+            classify(data, m);
+
+            // Backslashes are rare, so escapes are resolved one at a time.
+            uint64_t escaped = escape_next;
+            escape_next = 0;
+            for (uint64_t bs = m.backslash & ~escaped; bs != 0; bs &= bs - 1) {
+                int i = ctz64(bs);
+                if ((escaped >> i) & 1) {
+                    continue;
+                }
+                if (i == 63) {
+                    escape_next = 1;
+                } else {
+                    escaped |= uint64_t{1} << (i + 1);
+                }
+            }
+            uint64_t quotes = m.quote & ~escaped;
+            // Set for all bytes from an opening quote up to, not including,
+            // the closing quote.
+            uint64_t string_mask = prefix_xor(quotes) ^ in_string;
+            in_string = static_cast<uint64_t>(static_cast<int64_t>(string_mask) >> 63);
+
+            uint64_t outside = ~string_mask & ~quotes;
+            uint64_t structural = m.structural & outside;
+            uint64_t scalar = outside & ~m.structural & ~m.whitespace;
+            uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+            prev_scalar = scalar >> 63;
+
+            uint64_t all = structural | quotes | scalar_start;
+            if (in.size() - block < 64) {
+                all &= (uint64_t{1} << (in.size() - block)) - 1;
+            }
+            for (; all != 0; all &= all - 1) {
+                tokens.push_back(static_cast<uint32_t>(block + ctz64(all)));
+            }
+        }
+        // An unterminated string is reported by stage two, which finds any
+        // earlier error first, like the sequential parser does.
+    }
+
+    std::size_t next() {
+        if (pos >= tokens.size()) {
+            throw end_of_data();
+        }
+        return tokens[pos++];
+    }
+
+    void read_object() {
+        handler.start_object();
+        std::size_t ix = next();
+        if (in[ix] == '}') {
+            handler.end_object();
+            return;
+        }
+        while (true) {
+            if (in[ix] != '"') {
+                throw expected_char(ix, in, '"');
+            }
+            read_string(ix);
+            handler.key(string_value);
+            ix = next();
+            if (in[ix] != ':') {
+                throw expected_char(ix, in, ':');
+            }
+            read_value(next());
+            ix = next();
+            if (in[ix] == '}') {
+                handler.end_object();
+                return;
+            }
+            if (in[ix] != ',') {
+                throw unexpected_char(ix, in, in[ix]);
+            }
+            ix = next();
+        }
+    }
+
+    void read_list() {
+        handler.start_list();
+        std::size_t ix = next();
+        if (in[ix] == ']') {
+            handler.end_list();
+            return;
+        }
+        while (true) {
+            read_value(ix);
+            ix = next();
+            if (in[ix] == ']') {
+                handler.end_list();
+                return;
+            }
+            if (in[ix] != ',') {
+                throw unexpected_char(ix, in, in[ix]);
+            }
+            ix = next();
+        }
+    }
+
+    // Reads the string starting at the quote at ix into string_value.
+    void read_string(std::size_t ix) {
+        std::size_t end = next();
+        const char *begin = in.data() + ix + 1;
+        std::size_t len = end - ix - 1;
+        if (std::memchr(begin, '\\', len) == nullptr) {
+            string_value = std::string_view{begin, len};
+        } else {
+            ::read_string(ix, in, buffer);
+            string_value = buffer;
+        }
+    }
+
+    void read_value(std::size_t ix) {
+        switch (in[ix]) {
+        case '"':
+            read_string(ix);
+            handler.string(string_value);
+            return;
+        case '{':
+            read_object();
+            return;
+        case '[':
+            read_list();
+            return;
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9': {
+            int64_t i_val;
+            double d_val;
+            if (read_number(ix, in, i_val, d_val)) {
+                handler.integer(i_val);
+            } else {
+                handler.decimal(d_val);
+            }
             break;
-        case '\t':
-            os << "\\t";
+        }
+        case 'n':
+            read_matching(ix, in, "null");
+            handler.null();
             break;
-        case '\b':
-            os << "\\b";
+        case 't':
+            read_matching(ix, in, "true");
+            handler.boolean(true);
             break;
-        case '\f':
-            os << "\\f";
-        case '\r':
-            os << "\\r";
+        case 'f':
+            read_matching(ix, in, "false");
+            handler.boolean(false);
             break;
         default:
-            os << c;
+            throw unexpected_char(ix, in, in[ix]);
+        }
+        // The scalar has to end where its token does.
+        std::size_t after = ix + 1;
+        if (after < in.size() && (pos >= tokens.size() || after < tokens[pos])) {
+            char c = in[after];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                throw unexpected_char(after, in, c);
+            }
         }
     }
-    os << '"';
+
+    const std::string &in;
+    json::Handler &handler;
+
+    std::vector<uint32_t> tokens;
+    std::size_t pos = 0;
+
+    // Decoded strings with escapes.
+    std::string buffer;
+    std::string_view string_value;
+};
+
+} // namespace
+
+void json::parse(const std::string &in, json::Handler &handler) {
+    std::size_t ix = 0;
+    if (in.empty()) {
+        throw end_of_data();
+    }
+    if (in.size() >= STRUCTURAL_PARSE_THRESHOLD && in.size() <= UINT32_MAX) {
+        StructuralParser parser{in, handler};
+        parser.parse();
+        return;
+    }
+    if (in[0] != '{') {
+        skip_spacing(ix, in);
+    }
+    std::string buf;
+    read_object(ix, in, handler, buf);
 }
 
-void json::to_stream(std::ostream &os, const json::Type &val) {
-    if (const JsonObject *obj = val.get<JsonObject>()) {
-        obj->to_stream(os);
-    } else if (const JsonList *list = val.get<JsonList>()) {
-        list->to_stream(os);
-    } else if (val.type == Type::JSON_NULL) {
-        os << "null";
-    } else if (const int64_t *i = val.get<int64_t>()) {
-        os << *i;
-    } else if (const double *d = val.get<double>()) {
-        os << *d;
-    } else if (const bool *b = val.get<bool>()) {
-        if (*b)
-            os << "true";
-        else
-            os << "false";
-    } else if (const std::string *s = val.get<std::string>()) {
-        json::escape_string_to_stream(os, *s);
+json::Document json::read_from_string(const std::string& in) {
+    Document doc;
+    DomBuilder builder{*doc.arena};
+    parse(in, builder);
+    doc.root_obj = builder.result();
+    return doc;
+}
+
+void json::read_from_string(const std::string &in, Document &doc) {
+    if (doc.arena == nullptr) {
+        doc.arena = std::make_unique<Arena>();
+    } else {
+        doc.arena->reset();
     }
+    doc.root_obj = &EMPTY_OBJECT;
+    DomBuilder builder{*doc.arena};
+    parse(in, builder);
+    doc.root_obj = builder.result();
 }
 
-std::string json::write_to_string(const JsonObject &obj) {
-    return write_to_string(obj, true);
+namespace {
+
+constexpr std::size_t LINE_READ_SIZE = 64 * 1024;
+
+// Records are written once this much has been buffered.
+constexpr std::size_t LINE_FLUSH_SIZE = 64 * 1024;
+
+} // namespace
+
+json::LineReader::LineReader(const std::string &path) {
+#ifdef _WIN32
+    fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd < 0) {
+        throw json_exception("Failed opening '" + path +
+                             "': " + std::string(std::strerror(errno)));
+    }
 }
 
-std::string json::write_to_string(const JsonObject &obj, bool pretty) {
-    std::stringstream s;
+json::LineReader::~LineReader() {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+bool json::LineReader::read_line() {
+    while (true) {
+        std::size_t end = buffer.find('\n', std::max(start, scanned));
+        if (end != std::string::npos) {
+            line.assign(buffer, start, end - start);
+            start = end + 1;
+            return true;
+        }
+        scanned = buffer.size();
+        if (eof) {
+            if (start == buffer.size()) {
+                return false;
+            }
+            line.assign(buffer, start);
+            start = buffer.size();
+            return true;
+        }
+        buffer.erase(0, start);
+        scanned -= start;
+        start = 0;
+        std::size_t size = buffer.size();
+        buffer.resize(size + LINE_READ_SIZE);
+#ifdef _WIN32
+        int count = _read(fd, &buffer[size], static_cast<unsigned>(LINE_READ_SIZE));
+#else
+        ssize_t count = ::read(fd, &buffer[size], LINE_READ_SIZE);
+        if (count < 0 && errno == EINTR) {
+            buffer.resize(size);
+            continue;
+        }
+#endif
+        if (count < 0) {
+            buffer.resize(size);
+            throw json_exception("Failed reading json: " + std::string(std::strerror(errno)));
+        }
+        buffer.resize(size + static_cast<std::size_t>(count));
+        eof = count == 0;
+    }
+}
+
+bool json::LineReader::next(Document &doc) {
+    while (read_line()) {
+        ++line_no;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") == std::string::npos) {
+            continue;
+        }
+        try {
+            read_from_string(line, doc);
+        } catch (json_exception &e) {
+            throw json_exception("Line " + std::to_string(line_no) + ": " + e.msg);
+        }
+        return true;
+    }
+    return false;
+}
+
+json::LineWriter::LineWriter(const std::string &path) {
+#ifdef _WIN32
+    fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+               _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+    if (fd < 0) {
+        throw json_exception("Failed opening '" + path +
+                             "': " + std::string(std::strerror(errno)));
+    }
+}
+
+json::LineWriter::~LineWriter() {
+    try {
+        flush();
+    } catch (json_exception &) {
+    }
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+void json::LineWriter::write(const JsonObject &obj) {
+    writer.value(Type::make_object(&obj));
+    end_record();
+}
+
+void json::LineWriter::end_record() {
+    std::string &data = writer.data();
+    data.push_back('\n');
+    if (data.size() >= LINE_FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void json::LineWriter::flush() { writer.flush(fd); }
+
+namespace {
+
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// Appends the escaped form of c, which is a '"', '\\' or a control character.
+void escape_char(std::string &out, unsigned char c) {
+    switch (c) {
+    case '\\':
+        out.append("\\\\", 2);
+        break;
+    case '"':
+        out.append("\\\"", 2);
+        break;
+    case '\n':
+        out.append("\\n", 2);
+        break;
+    case '\t':
+        out.append("\\t", 2);
+        break;
+    case '\b':
+        out.append("\\b", 2);
+        break;
+    case '\f':
+        out.append("\\f", 2);
+        break;
+    case '\r':
+        out.append("\\r", 2);
+        break;
+    default: {
+        char esc[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf]};
+        out.append(esc, 6);
+    }
+    }
+}
+
+inline bool needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+} // namespace
+
+void json::escape_string(std::string &out, std::string_view s) {
+    out.push_back('"');
+    const char *data = s.data();
+    std::size_t size = s.size();
+    std::size_t i = 0;
+    std::size_t start = 0;
+#ifdef JSON_SSE2
+    // Find 16 bytes at a time if anything needs escaping, most strings
+    // are copied in a few appends.
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    while (i + 16 <= size) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        // max(v, 0x1f) == 0x1f only for bytes <= 0x1f, compared unsigned.
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+        while (mask != 0) {
+            std::size_t pos = i + count_trailing_zeros(mask);
+            out.append(data + start, pos - start);
+            escape_char(out, static_cast<unsigned char>(data[pos]));
+            start = pos + 1;
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+    for (; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (needs_escape(c)) {
+            out.append(data + start, i - start);
+            escape_char(out, c);
+            start = i + 1;
+        }
+    }
+    out.append(data + start, size - start);
+    out.push_back('"');
+}
+
+json::Writer::Writer(bool pretty, int indentations)
+    : pretty{pretty}, indentations{indentations} {}
+
+void json::Writer::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (counts.empty()) {
+        return;
+    }
+    if (counts.back()++ > 0) {
+        buffer.push_back(',');
+    }
     if (pretty) {
-        s << obj;
+        buffer.push_back('\n');
+        buffer.append(indentations + counts.size(), '\t');
+    }
+}
+
+void json::Writer::open(char c) {
+    separate();
+    buffer.push_back(c);
+    counts.push_back(0);
+}
+
+void json::Writer::close(char c) {
+    uint32_t count = counts.back();
+    counts.pop_back();
+    if (pretty && count > 0) {
+        buffer.push_back('\n');
+        buffer.append(indentations + counts.size(), '\t');
+    }
+    buffer.push_back(c);
+}
+
+void json::Writer::start_object() { open('{'); }
+
+void json::Writer::key(std::string_view key) {
+    separate();
+    escape_string(buffer, key);
+    if (pretty) {
+        buffer.append(" : ", 3);
+    } else {
+        buffer.push_back(':');
+    }
+    after_key = true;
+}
+
+void json::Writer::end_object() { close('}'); }
+
+void json::Writer::start_list() { open('['); }
+
+void json::Writer::end_list() { close(']'); }
+
+void json::Writer::string(std::string_view s) {
+    separate();
+    escape_string(buffer, s);
+}
+
+void json::Writer::integer(int64_t i) {
+    separate();
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), i);
+    buffer.append(buf, res.ptr);
+}
+
+void json::Writer::decimal(double d) {
+    if (!std::isfinite(d)) {
+        null();
+        return;
+    }
+    separate();
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), d);
+    buffer.append(buf, res.ptr);
+    // Keep the value a double when it is read back.
+    if (std::find_if(buf, res.ptr, [](char c) { return c == '.' || c == 'e'; }) == res.ptr) {
+        buffer.append(".0", 2);
+    }
+}
+
+void json::Writer::boolean(bool b) {
+    separate();
+    if (b) {
+        buffer.append("true", 4);
     } else {
-        obj.to_stream(s);
+        buffer.append("false", 5);
     }
-    return s.str();
 }
 
-void to_pretty_stream(std::ostream &os, const json::Type &val,
-                      int indentations) {
+void json::Writer::null() {
+    separate();
+    buffer.append("null", 4);
+}
+
+void json::Writer::value(const json::Type &val) {
     if (const JsonObject *obj = val.get<JsonObject>()) {
-        obj->to_pretty_stream(os, indentations);
+        start_object();
+        for (const auto &member : *obj) {
+            key(member.first);
+            value(member.second);
+        }
+        end_object();
     } else if (const JsonList *list = val.get<JsonList>()) {
-        list->to_pretty_stream(os, indentations);
-    } else if (val.type == json::Type::JSON_NULL) {
-        os << "null";
+        start_list();
+        for (const auto &v : *list) {
+            value(v);
+        }
+        end_list();
     } else if (const int64_t *i = val.get<int64_t>()) {
-        os << *i;
+        integer(*i);
     } else if (const double *d = val.get<double>()) {
-        os << *d;
+        decimal(*d);
     } else if (const bool *b = val.get<bool>()) {
-        if (*b)
-            os << "true";
-        else
-            os << "false";
-    } else if (const std::string *s = val.get<std::string>()) {
-        json::escape_string_to_stream(os, *s);
+        boolean(*b);
+    } else if (const std::string_view *s = val.get<std::string_view>()) {
+        string(*s);
+    } else {
+        null();
     }
 }
 
-std::unordered_map<std::string, json::Type>::iterator JsonObject::begin() {
-    return data.begin();
+std::string json::Writer::take() {
+    std::string res = std::move(buffer);
+    buffer.clear();
+    return res;
 }
-std::unordered_map<std::string, json::Type>::const_iterator JsonObject::begin() const {
-    return data.begin();
+
+void json::Writer::clear() { buffer.clear(); }
+
+void json::Writer::flush(int fd) {
+    const char *data = buffer.data();
+    std::size_t left = buffer.size();
+    while (left > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned>(std::min<std::size_t>(left, INT_MAX)));
+#else
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (written <= 0) {
+            throw json_exception("Failed writing json: " + std::string(std::strerror(errno)));
+        }
+        data += written;
+        left -= static_cast<std::size_t>(written);
+    }
+    buffer.clear();
 }
 
-std::unordered_map<std::string, json::Type>::iterator JsonObject::end() {
-    return data.end();
+void json::to_pretty_stream(std::ostream &os, const json::Type &val) {
+    Writer w{true};
+    w.value(val);
+    os.write(w.view().data(), w.view().size());
 }
-std::unordered_map<std::string, json::Type>::const_iterator JsonObject::end() const {
-    return data.end();
+
+void json::escape_string_to_stream(std::ostream &os, std::string_view s) {
+    std::string out;
+    escape_string(out, s);
+    os.write(out.data(), out.size());
 }
 
-std::list<std::string>::const_iterator JsonObject::keys_begin() const {
-    return keys.begin();
+void json::to_stream(std::ostream &os, const json::Type &val) {
+    Writer w{};
+    w.value(val);
+    os.write(w.view().data(), w.view().size());
 }
 
-std::list<std::string>::const_iterator JsonObject::keys_end() const {
-    return keys.end();
+std::string json::write_to_string(const JsonObject &obj) {
+    return write_to_string(obj, true);
 }
 
-void JsonObject::to_pretty_stream(std::ostream &os, int indentations) const {
-    os << '{';
-    if (data.empty()) {
-        os << '}';
-        return;
-    }
-    os << '\n';
+std::string json::write_to_string(const JsonObject &obj, bool pretty) {
+    Writer w{pretty};
+    w.value(json::Type::make_object(&obj));
+    return w.take();
+}
 
-    for (auto it = keys.cbegin(); it != keys.cend(); ++it) {
-        if (it != keys.begin())
-            os << ",\n";
-        for (int i = 0; i < indentations + 1; i++) {
-            os << '\t';
+const json::Type *JsonObject::find(std::string_view key) const {
+    for (std::size_t i = count; i > 0; --i) {
+        if (members[i - 1].first == key) {
+            return &members[i - 1].second;
         }
-        os << "\"" << *it << "\" : ";
-        const json::Type &val = data.at(*it);
-        ::to_pretty_stream(os, val, indentations + 1);
     }
-    os << '\n';
-    for (int i = 0; i < indentations; i++)
-        os << '\t';
-    os << '}';
+    return nullptr;
 }
 
-void JsonObject::to_stream(std::ostream &os) const {
-    os << '{';
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        if (it != keys.begin())
-            os << ',';
-        os << '"' << *it << "\":";
-        const json::Type &val = data.at(*it);
-        json::to_stream(os, val);
+const json::Type &JsonObject::get(std::string_view key) const {
+    const json::Type *val = find(key);
+    if (val == nullptr) {
+        throw json::missing_key(key);
     }
-    os << '}';
+    return *val;
 }
 
-void JsonList::to_pretty_stream(std::ostream &os, int indentations) const {
-    os << '[';
-    if (data.empty()) {
-        os << ']';
-        return;
-    }
-    os << '\n';
+void JsonObject::to_pretty_stream(std::ostream &os, int indentations) const {
+    json::Writer w{true, indentations};
+    w.value(json::Type::make_object(this));
+    os.write(w.view().data(), w.view().size());
+}
 
-    for (auto it = data.begin(); it != data.end(); ++it) {
-        if (it != data.begin())
-            os << ",\n";
-        for (int i = 0; i < indentations + 1; i++) {
-            os << '\t';
-        }
-        const json::Type &val = *it;
-        ::to_pretty_stream(os, val, indentations + 1);
-    }
-    os << '\n';
-    for (int i = 0; i < indentations; i++)
-        os << '\t';
-    os << ']';
+void JsonObject::to_stream(std::ostream &os) const {
+    json::Writer w{};
+    w.value(json::Type::make_object(this));
+    os.write(w.view().data(), w.view().size());
+}
+
+void JsonList::to_pretty_stream(std::ostream &os, int indentations) const {
+    json::Writer w{true, indentations};
+    w.value(json::Type::make_list(this));
+    os.write(w.view().data(), w.view().size());
 }
 
 void JsonList::to_stream(std::ostream &os) const {
-    os << '[';
-    for (auto it = data.begin(); it != data.end(); ++it) {
-        if (it != data.begin())
-            os << ',';
-        const json::Type &val = *it;
-        json::to_stream(os, val);
-    }
-    os << ']';
+    json::Writer w{};
+    w.value(json::Type::make_list(this));
+    os.write(w.view().data(), w.view().size());
 }
 
 std::ostream &operator<<(std::ostream &os, const JsonObject &obj) {
@@ -769,4 +1524,3 @@ std::ostream &operator<<(std::ostream &os, const JsonList &list) {
     list.to_pretty_stream(os, 0);
     return os;
 }
-
@@ -2,11 +2,13 @@
 #define JSON_00_H
 #include "engine/exceptions.h"
 #include <iostream>
-#include <list>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 /**
@@ -23,40 +25,354 @@ class JsonList;
 
 namespace json {
 
+/**
+ * Bump allocator that owns all nodes and strings of a Document.
+ * Nothing allocated from it is destroyed individually, everything is
+ * released at once when the arena is reset or destroyed.
+ */
+class Arena {
+public:
+    explicit Arena(std::size_t block_size = 16 * 1024);
+
+    Arena(const Arena &other) = delete;
+    Arena &operator=(const Arena &other) = delete;
+
+    ~Arena();
+
+    /**
+     * Allocates size bytes aligned to align. Never returns nullptr.
+     */
+    void *allocate(std::size_t size, std::size_t align);
+
+    /**
+     * Allocates space for count objects of type T, without constructing them.
+     */
+    template <class T> T *allocate_array(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Arena never runs destructors");
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /**
+     * Copies s into the arena.
+     */
+    std::string_view copy_string(std::string_view s);
+
+    /**
+     * Releases all allocations. The largest block is kept for reuse.
+     */
+    void reset();
+
+    /**
+     * Returns the number of bytes currently allocated from the system.
+     */
+    std::size_t capacity() const;
+
+private:
+    struct Block {
+        Block *prev;
+        std::size_t size;
+        std::size_t used;
+    };
+
+    Block *head = nullptr;
+    std::size_t block_size;
+};
+
+/**
+ * A json value. Objects, lists and strings are views into the Arena
+ * of the Document they belong to, so copying a Type is always shallow.
+ */
 struct Type {
-    enum { OBJECT, LIST, INTEGER, DOUBLE, BOOL, STRING, JSON_NULL } type;
+    enum : uint32_t { OBJECT, LIST, INTEGER, DOUBLE, BOOL, STRING, JSON_NULL } type;
 
 private:
     union {
-        JsonObject* object;
-        JsonList* list;
+        const JsonObject *object;
+        const JsonList *list;
         int64_t integer;
         double decimal;
         bool boolean;
-        std::string* str;
+        std::string_view str;
     };
 
-    void free();
+public:
+    Type() : type{JSON_NULL}, integer{0} {}
+
+    template <class T> const T *get() const;
+
+    static Type make_object(const JsonObject *obj);
+    static Type make_list(const JsonList *list);
+    static Type make_integer(int64_t i);
+    static Type make_decimal(double d);
+    static Type make_bool(bool b);
+    static Type make_string(std::string_view s);
+};
 
+/**
+ * A parsed json object together with the arena owning all of its values.
+ * Values obtained from a Document are valid as long as the Document is.
+ */
+class Document {
 public:
-    Type();
-    Type(const Type &other);
-    Type(Type &&other);
-    Type &operator=(const Type &other);
-    Type &operator=(Type &&other);
-    ~Type();
+    Document();
 
-    template <class T> T *get();
+    Document(Document &&other) noexcept = default;
+    Document &operator=(Document &&other) noexcept = default;
 
-    template <class T> const T *get() const;
+    const JsonObject &root() const { return *root_obj; }
+
+    const JsonObject *operator->() const { return root_obj; }
+
+    Arena &get_arena() { return *arena; }
+
+private:
+    friend Document read_from_string(const std::string &in);
+    friend void read_from_string(const std::string &in, Document &doc);
 
-    template <class T> void set(T t);
+    std::unique_ptr<Arena> arena;
+    const JsonObject *root_obj;
 };
 
 /**
- * Reads a JsonObject from a string.
+ * Receives the values of a json document in order, as they are read by
+ * json::parse. Strings passed to key and string are only valid until the
+ * call returns. Throwing from any callback aborts parsing.
  */
-JsonObject read_from_string(const std::string &in);
+class Handler {
+public:
+    virtual ~Handler() = default;
+
+    virtual void start_object() = 0;
+
+    /**
+     * Called before each value of an object, with the key of that value.
+     */
+    virtual void key(std::string_view key) = 0;
+
+    virtual void end_object() = 0;
+
+    virtual void start_list() = 0;
+
+    virtual void end_list() = 0;
+
+    virtual void string(std::string_view s) = 0;
+
+    virtual void integer(int64_t i) = 0;
+
+    virtual void decimal(double d) = 0;
+
+    virtual void boolean(bool b) = 0;
+
+    virtual void null() = 0;
+};
+
+/**
+ * Writes json text into a reusable buffer.
+ * Values are written in the order they are given, Writer does not check
+ * that they form a valid document. Being a Handler, it can be passed
+ * directly to json::parse.
+ */
+class Writer : public Handler {
+public:
+    /**
+     * @param pretty if true, indentations and newlines will be written.
+     * @param indentations the indentation level of the first value.
+     */
+    explicit Writer(bool pretty = false, int indentations = 0);
+
+    void start_object() override;
+
+    void key(std::string_view key) override;
+
+    void end_object() override;
+
+    void start_list() override;
+
+    void end_list() override;
+
+    void string(std::string_view s) override;
+
+    void integer(int64_t i) override;
+
+    /**
+     * Writes d in its shortest form that reads back exactly.
+     * NaN and infinities have no json representation and are written as null.
+     */
+    void decimal(double d) override;
+
+    void boolean(bool b) override;
+
+    void null() override;
+
+    /**
+     * Writes a json::Type, recursively.
+     */
+    void value(const Type &val);
+
+    /**
+     * Returns everything written since the last clear or flush.
+     */
+    std::string_view view() const { return buffer; }
+
+    /**
+     * Returns the buffer written to, for adding text between values such as
+     * the newlines that separate records.
+     */
+    std::string &data() { return buffer; }
+
+    /**
+     * Moves the written text out of the writer.
+     */
+    std::string take();
+
+    /**
+     * Discards the written text, keeping the buffer allocated.
+     */
+    void clear();
+
+    /**
+     * Writes the buffered text to a file descriptor and clears the buffer.
+     * Throws json_exception if writing fails.
+     */
+    void flush(int fd);
+
+private:
+    void separate();
+
+    void open(char c);
+
+    void close(char c);
+
+    std::string buffer;
+
+    // Number of values written in each open object or list.
+    std::vector<uint32_t> counts;
+
+    bool pretty;
+    int indentations;
+    bool after_key = false;
+};
+
+/**
+ * Appends s to out surrounded with quotes, escaping \, ", and all control
+ * characters.
+ */
+void escape_string(std::string &out, std::string_view s);
+
+/**
+ * Reads a json object from a string, passing every value to handler without
+ * building a JsonObject. Throws json_exception on invalid input.
+ */
+void parse(const std::string &in, Handler &handler);
+
+/**
+ * Reads a json object from a string into a new Document.
+ */
+Document read_from_string(const std::string &in);
+
+/**
+ * Reads a json object from a string into doc, replacing its previous content.
+ * The arena of doc is reset and reused, so values from doc obtained before
+ * the call are invalidated.
+ */
+void read_from_string(const std::string &in, Document &doc);
+
+/**
+ * Reads a newline delimited json file one record at a time.
+ * Each line holds one json object. Blank lines are skipped.
+ * Memory use is bounded by the longest line, not by the file size.
+ */
+class LineReader {
+public:
+    /**
+     * Opens the file at path. Throws json_exception on failure.
+     */
+    explicit LineReader(const std::string &path);
+
+    LineReader(const LineReader &other) = delete;
+    LineReader &operator=(const LineReader &other) = delete;
+
+    ~LineReader();
+
+    /**
+     * Reads the next record into doc, reusing its arena.
+     * Returns false when there are no more records.
+     * Throws json_exception, prefixed with the line number, if a record is
+     * invalid or reading fails.
+     */
+    bool next(Document &doc);
+
+    /**
+     * Returns the line number of the last record read, starting at 1.
+     */
+    std::size_t line_number() const { return line_no; }
+
+private:
+    // Moves the next line of the file into line. Returns false at the end.
+    bool read_line();
+
+    int fd;
+    bool eof = false;
+
+    // Bytes read from the file, starting at an unconsumed line.
+    std::string buffer;
+    std::size_t start = 0;
+    // Bytes from start up to here have been searched and hold no newline.
+    std::size_t scanned = 0;
+
+    std::string line;
+    std::size_t line_no = 0;
+};
+
+/**
+ * Appends records to a newline delimited json file.
+ * Records are buffered and written in large chunks, call flush to make sure
+ * everything written so far has reached the file.
+ */
+class LineWriter {
+public:
+    /**
+     * Opens the file at path for appending, creating it if needed.
+     * Throws json_exception on failure.
+     */
+    explicit LineWriter(const std::string &path);
+
+    LineWriter(const LineWriter &other) = delete;
+    LineWriter &operator=(const LineWriter &other) = delete;
+
+    /**
+     * Flushes and closes the file. Errors are ignored, call flush first to
+     * handle them.
+     */
+    ~LineWriter();
+
+    /**
+     * Appends obj as one record.
+     */
+    void write(const JsonObject &obj);
+
+    /**
+     * Returns the writer for the current record. Write exactly one object
+     * with it and then call end_record.
+     */
+    Writer &record() { return writer; }
+
+    /**
+     * Ends the record written through record().
+     */
+    void end_record();
+
+    /**
+     * Writes all buffered records to the file.
+     * Throws json_exception if writing fails.
+     */
+    void flush();
+
+private:
+    int fd;
+    Writer writer;
+};
 
 /**
  * Writes a JsonObject to a string, in prettified form with indentations and
@@ -85,87 +401,76 @@ void to_stream(std::ostream &os, const Type &type);
  * Writes a string to a stream surrounded with quotes and replaces \, ", LF,
  * tab, backspace, form feed and CR with
  * \\, \", \n, \t, \b, \f  and \r respectively.
+ * Other control characters are written as \u00XX.
  */
-void escape_string_to_stream(std::ostream &os, const std::string &s);
+void escape_string_to_stream(std::ostream &os, std::string_view s);
 } // namespace json
 
 /**
  * Class for representing a Json object.
+ * Members are stored flat in insertion order. Lookups are linear, which is
+ * faster than hashing for the small objects json files are made of.
  */
 class JsonObject {
 public:
+    typedef std::pair<std::string_view, json::Type> Member;
+
+    JsonObject() = default;
+
+    JsonObject(const Member *members, std::size_t count)
+        : members{members}, count{count} {}
+
     /**
      * Gets a value of type T with key key from the object.
+     * Throws json_exception if there is no such value.
      */
-    template <class T> T &get(const std::string &key);
-    template <class T> const T &get(const std::string &key) const;
+    template <class T> const T &get(std::string_view key) const;
 
     /**
      * Gets a value of type T with key key from the object.
      * If no such value exists, default_val is returned.
      */
     template <class T>
-    const T &get_default(const std::string &key, const T &default_val) const;
-    template <class T> T &get_default(const std::string &key, T &default_val);
+    const T &get_default(std::string_view key, const T &default_val) const;
 
     /**
      * Gets a json::Type with key key from the object.
+     * Throws json_exception if the key does not exist.
      */
-    const json::Type &get(const std::string &key) const { return data.at(key); }
-    json::Type &get(const std::string &key) { return data.at(key); }
-
-    /**
-     * Sets the value at key to value.
-     */
-    template <class T> void set(const std::string &key, T value);
+    const json::Type &get(std::string_view key) const;
 
     /**
-     * Gets a beginning iterator to the underlying map. No iteration order is
-     * guaranteed.
+     * Returns the value at key, or nullptr if it does not exist.
+     * If a key appears more than once, the last value is used.
      */
-    std::unordered_map<std::string, json::Type>::iterator begin();
-    std::unordered_map<std::string, json::Type>::const_iterator begin() const;
+    const json::Type *find(std::string_view key) const;
 
     /**
-     * Gets an end iterator to the underlying map.
-     */
-    std::unordered_map<std::string, json::Type>::iterator end();
-    std::unordered_map<std::string, json::Type>::const_iterator end() const;
-
-    /**
-     * Gets an beginning iterator to the keys of this object.
+     * Gets a beginning iterator to the members of this object.
      * The order of iteration is the order of insertion.
      */
-    std::list<std::string>::const_iterator keys_begin() const;
+    const Member *begin() const { return members; }
 
     /**
-     * Gets an end iterator to the keys of this object.
+     * Gets an end iterator to the members of this object.
      */
-    std::list<std::string>::const_iterator keys_end() const;
+    const Member *end() const { return members + count; }
 
     /**
      * Returns true if this object contains the key key.
      */
-    bool has_key(const std::string &key) const { return data.count(key) != 0; }
+    bool has_key(std::string_view key) const { return find(key) != nullptr; }
 
     /**
      * Returns true if this object contains the key key,
      *	and the value at key has the type T.
      */
-    template <class T> bool has_key_of_type(const std::string &key) const;
+    template <class T> bool has_key_of_type(std::string_view key) const;
 
     /**
      * Returns the number of elements in this object.
      */
-    size_t size() const { return data.size(); }
-
-    /**
-     * Removes all elements from this object.
-     */
-    void clear() {
-        data.clear();
-        keys.clear();
-    }
+    size_t size() const { return count; }
 
     /**
      * Outputs this object as text to a stream, using indentations and spaces.
@@ -180,9 +485,8 @@ public:
     void to_stream(std::ostream &os) const;
 
 private:
-    std::unordered_map<std::string, json::Type> data;
-
-    std::list<std::string> keys;
+    const Member *members = nullptr;
+    std::size_t count = 0;
 };
 
 /**
@@ -190,6 +494,11 @@ private:
  */
 class JsonList {
 public:
+    JsonList() = default;
+
+    JsonList(const json::Type *data, std::size_t count)
+        : data{data}, count{count} {}
+
     /**
      * Returns true if this list has an entry at index with type T.
      */
@@ -197,51 +506,29 @@ public:
 
     /**
      * Gets the element of type T at index from this list.
+     * Throws json_exception if the element has another type.
      */
-    template <class T> T &get(std::size_t ix);
-
     template <class T> const T &get(std::size_t ix) const;
 
     /**
      * Gets the json::Type at index from this list.
      */
-    json::Type &get(const unsigned index) { return data[index]; }
-
-    const json::Type &get(const unsigned index) const { return data[index]; }
-
-    /**
-     * Sets the entry at index to value.
-     */
-    template <class T> void set(std::size_t index, T value);
-
-    /**
-     * Append an element of type T to the end of the list.
-     */
-    template <class T> void push_back(T value);
+    const json::Type &get(const std::size_t index) const { return data[index]; }
 
     /**
      * Gets an iterator to the beginning of the list.
      */
-    std::vector<json::Type>::iterator begin() { return data.begin(); }
-    std::vector<json::Type>::const_iterator begin() const {
-        return data.begin();
-    }
+    const json::Type *begin() const { return data; }
 
     /**
      * Gets an iterator to the end of the list.
      */
-    std::vector<json::Type>::iterator end() { return data.end(); }
-    std::vector<json::Type>::const_iterator end() const { return data.end(); }
+    const json::Type *end() const { return data + count; }
 
     /**
      * Returns the number of entries in the list.
      */
-    size_t size() const { return data.size(); }
-
-    /**
-     * Removes all entries from the list.
-     */
-    void clear() { data.clear(); }
+    size_t size() const { return count; }
 
     /**
      * Outputs this list as a string to a stream, using indentations and spaces.
@@ -254,113 +541,82 @@ public:
     void to_stream(std::ostream &os) const;
 
 private:
-    std::vector<json::Type> data;
+    const json::Type *data = nullptr;
+    std::size_t count = 0;
 };
 
+static_assert(std::is_trivially_copyable_v<json::Type>,
+              "json::Type is copied by value out of the arena");
+static_assert(std::is_trivially_destructible_v<JsonObject::Member>,
+              "Members live in the arena");
+
 namespace json {
 
 template <> const JsonObject *Type::get() const;
 template <> const JsonList *Type::get() const;
-template <> const std::string *Type::get() const;
+template <> const std::string_view *Type::get() const;
 template <> const int64_t *Type::get() const;
 template <> const double *Type::get() const;
 template <> const bool *Type::get() const;
 
-template <> void Type::set(JsonObject obj);
-template <> void Type::set(JsonList list);
-template <> void Type::set(std::string s);
-template <> void Type::set(int64_t i);
-template <> void Type::set(double d);
-template <> void Type::set(bool b);
-template <> void Type::set(std::nullptr_t n);
-
-template <class T> void Type::set(T t) {
-    static_assert(std::is_same_v<T, JsonObject>, "Not a valid json type");
-}
-
 template <class T> const T *Type::get() const {
     static_assert(std::is_same_v<T, JsonObject>, "Not a valid json type");
 }
 
-template <class T> T *Type::get() {
-    return const_cast<T *>(const_cast<const Type *>(this)->get<T>());
-}
+json_exception missing_key(std::string_view key);
 
-} // namespace json
+json_exception wrong_type(std::string_view key);
 
-template <class T> T &JsonObject::get(const std::string &key) {
-    return *data.at(key).get<T>();
-}
-template <class T> const T &JsonObject::get(const std::string &key) const {
-    return *data.at(key).get<T>();
-}
+} // namespace json
 
-template <class T>
-const T &JsonObject::get_default(const std::string &key,
-                                 const T &default_val) const {
-    const auto el = data.find(key);
-    if (el == data.end())
-        return default_val;
-    const T *v = el->second.get<T>();
+template <class T> const T &JsonObject::get(std::string_view key) const {
+    const json::Type *val = find(key);
+    if (val == nullptr) {
+        throw json::missing_key(key);
+    }
+    const T *v = val->get<T>();
     if (v == nullptr) {
-        return default_val;
+        throw json::wrong_type(key);
     }
     return *v;
 }
 
 template <class T>
-T &JsonObject::get_default(const std::string &key, T &default_val) {
-    auto el = data.find(key);
-    if (el == data.end())
+const T &JsonObject::get_default(std::string_view key,
+                                 const T &default_val) const {
+    const json::Type *val = find(key);
+    if (val == nullptr) {
         return default_val;
-    T *v = el->second.get<T>();
+    }
+    const T *v = val->get<T>();
     if (v == nullptr) {
         return default_val;
     }
     return *v;
 }
 
-template <class T> void JsonObject::set(const std::string &key, T val) {
-    auto el = data.find(key);
-    if (el == data.end()) {
-        keys.push_back(key);
-        data[key].set<T>(std::move(val));
-    } else {
-        el->second.set<T>(std::move(val));
-    }
-}
-
 template <class T>
-bool JsonObject::has_key_of_type(const std::string &key) const {
-    auto el = data.find(key);
-    if (el == data.end()) {
+bool JsonObject::has_key_of_type(std::string_view key) const {
+    const json::Type *val = find(key);
+    if (val == nullptr) {
         return false;
     }
-    return el->second.get<T>() != nullptr;
+    return val->get<T>() != nullptr;
 }
 
 template <class T> bool JsonList::has_index_of_type(std::size_t ix) const {
-    if (ix >= data.size()) {
+    if (ix >= count) {
         return false;
     }
     return data[ix].get<T>() != nullptr;
 }
 
-template <class T> T &JsonList::get(std::size_t ix) {
-    return *data[ix].get<T>();
-}
-
 template <class T> const T &JsonList::get(std::size_t ix) const {
-    return *data[ix].get<T>();
-}
-
-template <class T> void JsonList::set(std::size_t ix, T val) {
-    data[ix].set<T>(std::move(val));
-}
-
-template <class T> void JsonList::push_back(T val) {
-    data.emplace_back();
-    data[data.size() - 1].set<T>(std::move(val));
+    const T *v = data[ix].get<T>();
+    if (v == nullptr) {
+        throw json::wrong_type("[" + std::to_string(ix) + "]");
+    }
+    return *v;
 }
 
 /**
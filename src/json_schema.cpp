@@ -0,0 +1,99 @@
+#include "json_schema.h"
+#include <cctype>
+
+json::decode_exception::decode_exception(std::string path, std::string problem)
+    : json_exception(""), path{std::move(path)}, problem{std::move(problem)} {
+    update();
+}
+
+void json::decode_exception::prepend(std::string_view key) {
+    if (path.empty() || path[0] == '[') {
+        path.insert(0, key);
+    } else {
+        path.insert(0, 1, '.');
+        path.insert(0, key);
+    }
+    update();
+}
+
+void json::decode_exception::prepend(std::size_t index) {
+    std::string prefix = "[" + std::to_string(index) + "]";
+    if (!path.empty() && path[0] != '[') {
+        prefix.push_back('.');
+    }
+    path.insert(0, prefix);
+    update();
+}
+
+void json::decode_exception::update() {
+    if (path.empty()) {
+        msg = problem;
+    } else {
+        msg = path + ": " + problem;
+    }
+}
+
+bool json::equals_upper(std::string_view s, std::string_view upper) {
+    if (s.size() != upper.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (std::toupper(static_cast<unsigned char>(s[i])) != upper[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void json::decode_upper(const Type &val, std::string &out) {
+    const std::string_view *s = val.get<std::string_view>();
+    if (s == nullptr) {
+        throw decode_exception("", "expected a string");
+    }
+    out.resize(s->size());
+    for (std::size_t i = 0; i < s->size(); ++i) {
+        out[i] = static_cast<char>(std::toupper(static_cast<unsigned char>((*s)[i])));
+    }
+}
+
+void json::Decoder<int64_t>::decode(const Type &val, int64_t &out) {
+    const int64_t *i = val.get<int64_t>();
+    if (i == nullptr) {
+        throw decode_exception("", "expected an integer");
+    }
+    out = *i;
+}
+
+void json::Decoder<uint64_t>::decode(const Type &val, uint64_t &out) {
+    const int64_t *i = val.get<int64_t>();
+    if (i == nullptr || *i < 0) {
+        throw decode_exception("", "expected a non-negative integer");
+    }
+    out = static_cast<uint64_t>(*i);
+}
+
+void json::Decoder<double>::decode(const Type &val, double &out) {
+    if (const double *d = val.get<double>()) {
+        out = *d;
+    } else if (const int64_t *i = val.get<int64_t>()) {
+        out = static_cast<double>(*i);
+    } else {
+        throw decode_exception("", "expected a number");
+    }
+}
+
+void json::Decoder<bool>::decode(const Type &val, bool &out) {
+    const bool *b = val.get<bool>();
+    if (b == nullptr) {
+        throw decode_exception("", "expected a bool");
+    }
+    out = *b;
+}
+
+void json::Decoder<std::string>::decode(const Type &val, std::string &out) {
+    const std::string_view *s = val.get<std::string_view>();
+    if (s == nullptr) {
+        throw decode_exception("", "expected a string");
+    }
+    out.assign(s->data(), s->size());
+}
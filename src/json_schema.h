@@ -0,0 +1,248 @@
+#ifndef PROC_ASM_JSON_SCHEMA_H
+#define PROC_ASM_JSON_SCHEMA_H
+#include "json.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace json {
+
+/**
+ * decode_exception, for when a json value does not match the type it is
+ * decoded into. The message starts with the path of the value, like
+ * "ports[2].data_type: expected a string".
+ */
+class decode_exception : public json_exception {
+public:
+    decode_exception(std::string path, std::string problem);
+
+    /**
+     * Prepends the key of an enclosing object to the path.
+     */
+    void prepend(std::string_view key);
+
+    /**
+     * Prepends the index of an enclosing list to the path.
+     */
+    void prepend(std::size_t index);
+
+    const std::string &get_path() const { return path; }
+
+private:
+    void update();
+
+    std::string path;
+    std::string problem;
+};
+
+/**
+ * Decodes a json value into a T. Specialized for integers, doubles, bools,
+ * strings, vectors, enums with EnumNames and structs with a Schema.
+ * A decode function throws decode_exception if the value does not match.
+ */
+template <class T, class Enable = void> struct Decoder;
+
+/**
+ * A field of the struct S: the key it is read from and how to decode it.
+ */
+template <class S> struct Field {
+    std::string_view key;
+    void (*decode)(const Type &val, S &out);
+    bool required;
+};
+
+/**
+ * Specialize with a static constexpr array of Field<T> named fields to make
+ * T decodable from a json object.
+ */
+template <class T> struct Schema {};
+
+/**
+ * A name of an enum value. Names are matched ignoring case, and are stored
+ * in upper case.
+ */
+template <class T> struct EnumName {
+    std::string_view name;
+    T value;
+};
+
+/**
+ * Specialize with a static constexpr array of EnumName<T> named names to make
+ * the enum T decodable from a json string.
+ */
+template <class T> struct EnumNames {};
+
+template <class M> struct member_pointer_traits;
+
+template <class S, class T> struct member_pointer_traits<T S::*> {
+    typedef S object_type;
+    typedef T value_type;
+};
+
+template <auto Member>
+using member_object_t = typename member_pointer_traits<decltype(Member)>::object_type;
+
+template <auto Member>
+using member_value_t = typename member_pointer_traits<decltype(Member)>::value_type;
+
+template <auto Member> void decode_member(const Type &val, member_object_t<Member> &out) {
+    Decoder<member_value_t<Member>>::decode(val, out.*Member);
+}
+
+template <auto Member, auto Decode>
+void decode_member_with(const Type &val, member_object_t<Member> &out) {
+    Decode(val, out.*Member);
+}
+
+/**
+ * Describes a field read from key into Member, using its Decoder.
+ */
+template <auto Member>
+constexpr Field<member_object_t<Member>> field(std::string_view key,
+                                               bool required = true) {
+    return {key, &decode_member<Member>, required};
+}
+
+/**
+ * Describes a field read from key into Member, using Decode, a function
+ * taking (const Type &, T &).
+ */
+template <auto Member, auto Decode>
+constexpr Field<member_object_t<Member>> field(std::string_view key,
+                                               bool required = true) {
+    return {key, &decode_member_with<Member, Decode>, required};
+}
+
+/**
+ * Decodes obj into out, visiting every member of obj once.
+ * Members with keys not in fields are ignored. If a key appears more than
+ * once, the last value is used.
+ */
+template <class S, std::size_t N>
+void decode_object(const JsonObject &obj, S &out, const Field<S> (&fields)[N]) {
+    static_assert(N <= 64, "Too many fields");
+    uint64_t seen = 0;
+    for (const auto &member : obj) {
+        for (std::size_t i = 0; i < N; ++i) {
+            if (fields[i].key != member.first) {
+                continue;
+            }
+            try {
+                fields[i].decode(member.second, out);
+            } catch (decode_exception &e) {
+                e.prepend(member.first);
+                throw;
+            }
+            seen |= uint64_t{1} << i;
+            break;
+        }
+    }
+    for (std::size_t i = 0; i < N; ++i) {
+        if (fields[i].required && !((seen >> i) & 1)) {
+            throw decode_exception(std::string(fields[i].key), "missing key");
+        }
+    }
+}
+
+/**
+ * Decodes val into out, throwing decode_exception on mismatch.
+ */
+template <class T> void decode(const Type &val, T &out) {
+    Decoder<T>::decode(val, out);
+}
+
+/**
+ * Decodes obj into the struct out, using Schema<T>.
+ */
+template <class T> void decode(const JsonObject &obj, T &out) {
+    decode_object(obj, out, Schema<T>::fields);
+}
+
+/**
+ * Returns true if s equals upper ignoring case. upper has to be in upper case.
+ */
+bool equals_upper(std::string_view s, std::string_view upper);
+
+/**
+ * Decodes a string, converting it to upper case.
+ */
+void decode_upper(const Type &val, std::string &out);
+
+template <> struct Decoder<int64_t> {
+    static void decode(const Type &val, int64_t &out);
+};
+
+/**
+ * Decodes a non-negative integer.
+ */
+template <> struct Decoder<uint64_t> {
+    static void decode(const Type &val, uint64_t &out);
+};
+
+/**
+ * Decodes a number, integers are converted.
+ */
+template <> struct Decoder<double> {
+    static void decode(const Type &val, double &out);
+};
+
+template <> struct Decoder<bool> {
+    static void decode(const Type &val, bool &out);
+};
+
+template <> struct Decoder<std::string> {
+    static void decode(const Type &val, std::string &out);
+};
+
+template <class T> struct Decoder<std::vector<T>> {
+    static void decode(const Type &val, std::vector<T> &out) {
+        const JsonList *list = val.get<JsonList>();
+        if (list == nullptr) {
+            throw decode_exception("", "expected a list");
+        }
+        out.clear();
+        out.resize(list->size());
+        for (std::size_t i = 0; i < list->size(); ++i) {
+            try {
+                Decoder<T>::decode(list->get(i), out[i]);
+            } catch (decode_exception &e) {
+                e.prepend(i);
+                throw;
+            }
+        }
+    }
+};
+
+template <class T>
+struct Decoder<T, std::void_t<decltype(Schema<T>::fields)>> {
+    static void decode(const Type &val, T &out) {
+        const JsonObject *obj = val.get<JsonObject>();
+        if (obj == nullptr) {
+            throw decode_exception("", "expected an object");
+        }
+        decode_object(*obj, out, Schema<T>::fields);
+    }
+};
+
+template <class T>
+struct Decoder<T, std::void_t<decltype(EnumNames<T>::names)>> {
+    static void decode(const Type &val, T &out) {
+        const std::string_view *s = val.get<std::string_view>();
+        if (s == nullptr) {
+            throw decode_exception("", "expected a string");
+        }
+        for (const auto &name : EnumNames<T>::names) {
+            if (equals_upper(*s, name.name)) {
+                out = name.value;
+                return;
+            }
+        }
+        throw decode_exception("", "invalid value '" + std::string(*s) + "'");
+    }
+};
+
+} // namespace json
+
+#endif
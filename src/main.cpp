@@ -1,34 +1,55 @@
 #include "assembly.h"
+#include "headless.h"
 #include "engine/log.h"
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <engine/engine.h>
 #include <engine/game.h>
+#include <chrono>
+#include <future>
 #include <memory>
 #include "registers.h"
 
+namespace {
+
+using StartupClock = std::chrono::steady_clock;
+
+// Milliseconds since start, for the startup timing report.
+double ms_since(StartupClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(StartupClock::now() - start).count();
+}
+
+}
+
 class SDL_context {
 public:
     SDL_context() {
         LOG_INFO("Initializing SDL");
         //SDL_SetHint(SDL_HINT_WINDOWS_DPI_AWARENESS, "permonitorv2");
         SDL_SetHint(SDL_HINT_WINDOWS_DPI_SCALING, "1");
+        auto start = StartupClock::now();
         if (SDL_Init(SDL_INIT_VIDEO) < 0) {
             LOG_CRITICAL("Failed initializing SDL: %s", SDL_GetError());
             exit(1);
         }
+        LOG_INFO("Startup: SDL video %.1f ms", ms_since(start));
+        start = StartupClock::now();
         if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0) {
             LOG_CRITICAL("Failed initializing SDL_image: %s", IMG_GetError());
             SDL_Quit();
             exit(1);
         }
+        LOG_INFO("Startup: SDL_image %.1f ms", ms_since(start));
+        start = StartupClock::now();
         if (TTF_Init() < 0) {
             LOG_CRITICAL("Failed initializing SDL_ttf: %s", TTF_GetError());
             IMG_Quit();
             SDL_Quit();
             exit(1);
         }
+        LOG_INFO("Startup: SDL_ttf %.1f ms", ms_since(start));
+        start = StartupClock::now();
         try {
             engine::init();
         } catch (base_exception& e) {
@@ -38,6 +59,7 @@ public:
             SDL_Quit();
             exit(1);
         }
+        LOG_INFO("Startup: engine and font %.1f ms", ms_since(start));
         initialized = true;
     }
 
@@ -57,15 +79,11 @@ private:
 
 std::unique_ptr<SDL_context> context;
 
-int main(int argv, char* argc[]) {
-    context = std::make_unique<SDL_context>();
-
-    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG);
-
-    SDL_RWops* presets = SDL_RWFromFile("presets.json", "r");
+bool load_templates(const char* path, std::vector<ProcessorTemplate>& templates) {
+    SDL_RWops* presets = SDL_RWFromFile(path, "r");
     if (presets == nullptr) {
         LOG_CRITICAL("Failed opening presets file: %s", SDL_GetError());
-        return 1;
+        return false;
     }
     std::size_t size = SDL_RWsize(presets);
     std::string str;
@@ -73,39 +91,84 @@ int main(int argv, char* argc[]) {
     if (SDL_RWread(presets, &str[0], 1, size) != size) {
         LOG_CRITICAL("Failed reading presets file");
         SDL_RWclose(presets);
-        return 1;
+        return false;
     }
 
     SDL_RWclose(presets);
-    std::vector<ProcessorTemplate> templates;
     try {
-        JsonObject obj = json::read_from_string(str);
+        json::Document doc = json::read_from_string(str);
+        const JsonObject& obj = doc.root();
         if (!obj.has_key_of_type<JsonList>("processors")) {
             LOG_CRITICAL("Failed parsing processor templates");
-            return 1;
+            return false;
         }
-        for (auto& o : obj.get<JsonList>("processors")) {
-            if (JsonObject* obj = o.get<JsonObject>()) {
-                templates.emplace_back();
-                if (!templates.back().read_from_json(*obj)) {
-                    LOG_ERROR("Failed parsing processor template");
-                    templates.pop_back();
-                    continue;
+        const JsonList& processors = obj.get<JsonList>("processors");
+        for (std::size_t i = 0; i < processors.size(); ++i) {
+            templates.emplace_back();
+            try {
+                const JsonObject* tmpl = processors.get(i).get<JsonObject>();
+                if (tmpl == nullptr) {
+                    throw json::decode_exception("", "expected an object");
                 }
-            } else {
-                LOG_ERROR("Failed parsing processor template");
+                templates.back().read_from_json(*tmpl);
+            } catch (json::decode_exception& e) {
+                e.prepend(i);
+                e.prepend("processors");
+                LOG_ERROR("Failed parsing processor template: %s", e.msg.c_str());
+                templates.pop_back();
             }
         }
         if (templates.size() == 0) {
             LOG_CRITICAL("No valid processor templates in file");
-            return 1;
+            return false;
         }
     } catch (json_exception& e) {
-        LOG_CRITICAL("Failed parsing presets.json: %s", e.msg.c_str());
+        LOG_CRITICAL("Failed parsing %s: %s", path, e.msg.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argv, char* argc[]) {
+    if (is_headless(argv, argc)) {
+        logging::set_priority(SDL_LOG_PRIORITY_INFO);
+        std::vector<ProcessorTemplate> templates;
+        if (!load_templates("presets.json", templates)) {
+            return 1;
+        }
+        return run_headless(argv, argc, templates);
+    }
+
+    auto start = StartupClock::now();
+    logging::set_priority(SDL_LOG_PRIORITY_INFO);
+    // e.g. PROCASM_LOG=compiler=debug,processor=verbose
+    if (const char *spec = std::getenv("PROCASM_LOG")) {
+        if (!logging::configure(spec)) {
+            LOG_WARNING("Could not parse all of PROCASM_LOG '%s'", spec);
+        }
+    }
+
+    // Presets do not depend on SDL, parse them while the libraries initialize.
+    std::vector<ProcessorTemplate> templates;
+    double presets_ms = 0.0;
+    std::future<bool> presets = std::async(std::launch::async, [&templates, &presets_ms]() {
+        auto presets_start = StartupClock::now();
+        bool ok = load_templates("presets.json", templates);
+        presets_ms = ms_since(presets_start);
+        return ok;
+    });
+
+    context = std::make_unique<SDL_context>();
+
+    auto wait_start = StartupClock::now();
+    bool presets_ok = presets.get();
+    LOG_INFO("Startup: presets %.1f ms on worker, waited %.1f ms, total %.1f ms",
+             presets_ms, ms_since(wait_start), ms_since(start));
+    if (!presets_ok) {
         return 1;
     }
 
-    LOG_DEBUG("%d processors loaded", templates.size());
+    LOG_DEBUG("%llu processors loaded", static_cast<unsigned long long>(templates.size()));
     StateGame game {new GameState(std::move(templates)), 1920, 1080, "Text box!!!"};
     try {
         game.create();
@@ -10,3 +10,7 @@ void OverlayMenu::render() {
     SDL_RenderFillRect(gRenderer, &r);
     Menu::render();
 }
+
+bool OverlayMenu::is_dirty() const {
+    return parent->is_dirty() || Menu::is_dirty();
+}
@@ -7,6 +7,8 @@ public:
     OverlayMenu(State* parent);
 
     void render() override;
+
+    bool is_dirty() const override;
 protected:
     State* parent;
 };
@@ -3,6 +3,7 @@
 #include "cassert"
 #include "engine/log.h"
 #include "json.h"
+#include "json_schema.h"
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -47,55 +48,32 @@ struct PortTemplate {
     PortDatatype data_type;
     PortType port_type;
 
-    bool read_from_json(const JsonObject &obj) {
-        if (!obj.has_key_of_type<std::string>("name")) {
-            return false;
-        }
-        if (!obj.has_key_of_type<std::string>("data_type")) {
-            return false;
-        }
-        if (!obj.has_key_of_type<std::string>("port_type")) {
-            return false;
-        }
-        name = obj.get<std::string>("name");
-        const std::string &dt = obj.get<std::string>("data_type");
-        const std::string &pt = obj.get<std::string>("port_type");
-        auto eq = [](const std::string &a, const std::string &b) -> bool {
-            if (a.size() != b.size()) {
-                return false;
-            }
-            for (std::size_t i = 0; i < a.size(); ++i) {
-                if (std::toupper(a[i]) != b[i]) {
-                    return false;
-                }
-            }
-            return true;
-        };
-        if (eq(dt, "WORD")) {
-            data_type = PortDatatype::WORD;
-        } else if (eq(dt, "DWORD")) {
-            data_type = PortDatatype::DWORD;
-        } else if (eq(dt, "QWORD")) {
-            data_type = PortDatatype::QWORD;
-        } else if (eq(dt, "BYTE")) {
-            data_type = PortDatatype::BYTE;
-        } else {
-            LOG_WARNING("Invalid port data type '%s'", dt.c_str());
-            data_type = PortDatatype::BYTE;
-        }
-        if (eq(pt, "BLOCKING")) {
-            port_type = PortType::BLOCKING;
-        } else {
-            LOG_WARNING("Invalid port type '%s'", pt.c_str());
-            port_type = PortType::BLOCKING;
-        }
+    std::shared_ptr<SharedPort> instantiate() const;
+};
 
-        return true;
-    }
+namespace json {
 
-    std::shared_ptr<SharedPort> instantiate() const;
+template <> struct EnumNames<PortDatatype> {
+    static constexpr EnumName<PortDatatype> names[] = {
+        {"BYTE", PortDatatype::BYTE},
+        {"WORD", PortDatatype::WORD},
+        {"DWORD", PortDatatype::DWORD},
+        {"QWORD", PortDatatype::QWORD}};
 };
 
+template <> struct EnumNames<PortType> {
+    static constexpr EnumName<PortType> names[] = {{"BLOCKING", PortType::BLOCKING}};
+};
+
+template <> struct Schema<PortTemplate> {
+    static constexpr Field<PortTemplate> fields[] = {
+        field<&PortTemplate::name>("name"),
+        field<&PortTemplate::data_type>("data_type"),
+        field<&PortTemplate::port_type>("port_type")};
+};
+
+} // namespace json
+
 template <class T> constexpr bool is_valid_type() {
     return std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
            std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>;
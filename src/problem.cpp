@@ -58,6 +58,14 @@ bool ByteProblem::poll_output(std::size_t ix, std::string& s) {
     return false;
 }
 
+std::size_t ByteProblem::input_count() const {
+    return input_ports.size();
+}
+
+std::size_t ByteProblem::output_count() const {
+    return output_ports.size();
+}
+
 void ByteProblem::in_tick() {
     if (output_ports[0] != nullptr) {
         output_ports[0]->prepare_pop();
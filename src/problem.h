@@ -27,6 +27,10 @@ public:
     bool poll_input(std::size_t ix, std::string& s);
 
     bool poll_output(std::size_t ix, std::string& s);
+
+    std::size_t input_count() const;
+
+    std::size_t output_count() const;
 private:
     friend class ProcessorGui;
 
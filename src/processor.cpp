@@ -70,102 +70,155 @@ void ProcessorTemplate::validate() {
     }
 }
 
-bool ProcessorTemplate::read_from_json(const JsonObject &obj) {
-    if (!obj.has_key_of_type<std::string>("name")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<JsonList>("ports")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<JsonList>("registers")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<int64_t>("max_instructions")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<JsonObject>("instructions")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<int64_t>("features")) {
-        return false;
-    }
-    if (!obj.has_key_of_type<int64_t>("port_layout")) {
-        return false;
+namespace {
+
+enum class RegisterType { BYTE, WORD, DWORD, QWORD, FLOAT, DOUBLE };
+
+struct RegisterTemplate {
+    std::string name;
+    RegisterType type;
+};
+
+void decode_features(const json::Type &val, feature_t &out) {
+    int64_t features;
+    json::decode(val, features);
+    out = features & ProcessorFeature::ALL;
+}
+
+void decode_port_layout(const json::Type &val, PortLayout &out) {
+    int64_t layout;
+    json::decode(val, layout);
+    out.up = layout & 0xff;
+    out.right = (layout >> 8) & 0xff;
+    out.down = (layout >> 16) & 0xff;
+    out.left = (layout >> 24) & 0xff;
+}
+
+void decode_registers(const json::Type &val, ProcessorTemplate &out) {
+    std::vector<RegisterTemplate> registers;
+    json::decode(val, registers);
+    out.genreg_names.clear();
+    out.floatreg_names.clear();
+    for (auto &reg : registers) {
+        switch (reg.type) {
+        case RegisterType::BYTE:
+            out.genreg_names.push_back({std::move(reg.name), DataSize::BYTE});
+            break;
+        case RegisterType::WORD:
+            out.genreg_names.push_back({std::move(reg.name), DataSize::WORD});
+            break;
+        case RegisterType::DWORD:
+            out.genreg_names.push_back({std::move(reg.name), DataSize::DWORD});
+            break;
+        case RegisterType::QWORD:
+            out.genreg_names.push_back({std::move(reg.name), DataSize::QWORD});
+            break;
+        case RegisterType::FLOAT:
+            out.floatreg_names.push_back({std::move(reg.name), DataSize::DWORD});
+            break;
+        case RegisterType::DOUBLE:
+            out.floatreg_names.push_back({std::move(reg.name), DataSize::QWORD});
+            break;
+        }
     }
+}
 
-    name = obj.get<std::string>("name");
-    instruction_slots = obj.get<int64_t>("max_instructions");
-    features = obj.get<int64_t>("features") & ProcessorFeature::ALL;
-    int64_t layout = obj.get<int64_t>("port_layout");
-    port_layout.up = layout & 0xff;
-    port_layout.right = (layout >> 8) & 0xff;
-    port_layout.down = (layout >> 16) & 0xff;
-    port_layout.left = (layout >> 24) & 0xff;
-
-    const JsonList &ports = obj.get<JsonList>("ports");
-    this->ports.clear();
-    for (const auto &val : ports) {
-        if (const JsonObject *port = val.get<JsonObject>()) {
-            PortTemplate t;
-            if (!t.read_from_json(*port)) {
-                continue;
-            }
-            this->ports.push_back(t);
+void decode_instructions(const json::Type &val, InstructionSet &out) {
+    const JsonObject *obj = val.get<JsonObject>();
+    if (obj == nullptr) {
+        throw json::decode_exception("", "expected an object");
+    }
+    out.clear();
+    std::string key;
+    for (const auto &kv : *obj) {
+        const int64_t *i = kv.second.get<int64_t>();
+        if (i == nullptr) {
+            throw json::decode_exception(std::string(kv.first), "expected an integer");
         }
+        key.resize(kv.first.size());
+        std::transform(kv.first.begin(), kv.first.end(), key.begin(),
+                       [](unsigned char c) { return std::toupper(c); });
+        out[key] = instruction_from_ix(*i);
     }
-    if (this->ports.size() != port_layout.total()) {
-        return false;
+}
+
+} // namespace
+
+namespace json {
+
+template <> struct EnumNames<RegisterType> {
+    static constexpr EnumName<RegisterType> names[] = {
+        {"BYTE", RegisterType::BYTE},   {"WORD", RegisterType::WORD},
+        {"DWORD", RegisterType::DWORD}, {"QWORD", RegisterType::QWORD},
+        {"FLOAT", RegisterType::FLOAT}, {"DOUBLE", RegisterType::DOUBLE}};
+};
+
+template <> struct Schema<RegisterTemplate> {
+    static constexpr Field<RegisterTemplate> fields[] = {
+        field<&RegisterTemplate::name, decode_upper>("name"),
+        field<&RegisterTemplate::type>("type")};
+};
+
+template <> struct Schema<ProcessorTemplate> {
+    static constexpr Field<ProcessorTemplate> fields[] = {
+        field<&ProcessorTemplate::name>("name"),
+        field<&ProcessorTemplate::ports>("ports"),
+        Field<ProcessorTemplate>{"registers", &decode_registers, true},
+        field<&ProcessorTemplate::instruction_slots>("max_instructions"),
+        field<&ProcessorTemplate::instruction_set, decode_instructions>("instructions"),
+        field<&ProcessorTemplate::features, decode_features>("features"),
+        field<&ProcessorTemplate::port_layout, decode_port_layout>("port_layout")};
+};
+
+} // namespace json
+
+void ProcessorTemplate::read_from_json(const JsonObject &obj) {
+    json::decode(obj, *this);
+    if (ports.size() != port_layout.total()) {
+        throw json::decode_exception("ports", "expected " +
+                                                  std::to_string(port_layout.total()) +
+                                                  " ports to match port_layout");
     }
+    validate();
+}
 
-    const JsonList &registers = obj.get<JsonList>("registers");
-    this->genreg_names.clear();
-    for (const auto &val : registers) {
-        if (const JsonObject *reg = val.get<JsonObject>()) {
-            if (!reg->has_key_of_type<std::string>("name")) {
-                continue;
-            }
-            if (!reg->has_key_of_type<std::string>("type")) {
-                continue;
-            }
-            std::string name = reg->get<std::string>("name");
-            for (auto &c : name) {
-                c = std::toupper(c);
-            }
-            std::string type = reg->get<std::string>("type");
-            for (auto &c : type) {
-                c = std::toupper(c);
-            }
-            if (type == "FLOAT") {
-                floatreg_names.push_back({name, DataSize::DWORD});
-            } else if (type == "DOUBLE") {
-                floatreg_names.push_back({name, DataSize::QWORD});
-            } else if (type == "BYTE") {
-                genreg_names.push_back({name, DataSize::BYTE});
-            } else if (type == "WORD") {
-                genreg_names.push_back({name, DataSize::WORD});
-            } else if (type == "DWORD") {
-                genreg_names.push_back({name, DataSize::DWORD});
-            } else if (type == "QWORD") {
-                genreg_names.push_back({name, DataSize::QWORD});
-            } else {
-                LOG_WARNING("Invalid register type: '%s'", type.c_str());
-            }
+uint64_t ProcessorTemplate::fingerprint() const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto add = [&hash](uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (v >> (8 * i)) & 0xff;
+            hash *= 0x100000001b3ull;
         }
-    }
-    const JsonObject &instr = obj.get<JsonObject>("instructions");
-    instruction_set.clear();
-    for (const auto &kv : instr) {
-        if (const int64_t *i = kv.second.get<int64_t>()) {
-            std::string key = kv.first;
-            for (auto &c : key) {
-                c = std::toupper(c);
-            }
-            instruction_set[key] = instruction_from_ix(*i);
+    };
+    auto add_str = [&hash, &add](const std::string& s) {
+        add(s.size());
+        for (char c : s) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+    };
+    add(features);
+    add(instruction_slots);
+    add(port_layout.up | (port_layout.right << 8) |
+        (port_layout.down << 16) | (port_layout.left << 24));
+    add(ports.size());
+    for (auto& port : ports) {
+        add(static_cast<uint64_t>(port.data_type));
+        add(static_cast<uint64_t>(port.port_type));
+    }
+    for (const RegisterNames* names : {&genreg_names, &floatreg_names}) {
+        add(names->size());
+        for (auto& reg : *names) {
+            add_str(reg.first);
+            add(static_cast<uint64_t>(reg.second));
         }
     }
-
-    validate();
-    return true;
+    add(instruction_set.size());
+    for (auto& kv : instruction_set) {
+        add_str(kv.first);
+        add(static_cast<uint64_t>(kv.second));
+    }
+    return hash;
 }
 
 Processor ProcessorTemplate::instantiate() const {
@@ -187,24 +240,51 @@ Processor::Processor(std::vector<std::shared_ptr<SharedPort>> ports,
     : ports{std::move(ports)}, 
     instruction_set{std::move(instruction_set)}, port_layout{port_layout},
       registers{std::move(registers)}, pc{0}, ticks{0}, features{features} {
-    LOG_DEBUG("Size: %d", registers.count_genreg());
+    LOG_DEBUG_CAT(LogCategory::PROCESSOR, "Size: %llu",
+                  static_cast<unsigned long long>(registers.count_genreg()));
     instructions.push_back({InstructionType::NOP});
     instructions.back().line = 0;
 }
 
 bool Processor::compile_program(const std::vector<std::string> lines,
                                 std::vector<ErrorMsg> &errors) {
-    LOG_DEBUG("COMPILE called");
+    LOG_DEBUG_CAT(LogCategory::PROCESSOR, "COMPILE called");
     std::vector<std::string> port_names;
     for (uint16_t i = 0; i < port_layout.total(); ++i) {
         port_names.push_back(port_layout.name(i));
     }
+    CompileResult result;
     Compiler c{registers, std::move(port_names),
-               instructions, instruction_set, features};
-    valid = c.compile(lines, errors);
+               result.instructions, instruction_set, features};
+    result.valid = c.compile(lines, errors);
+    return load_program(result);
+}
+
+CompileJob Processor::create_compile_job(
+    std::shared_ptr<const std::vector<std::string>> lines) const {
+    std::vector<std::string> port_names;
+    for (uint16_t i = 0; i < port_layout.total(); ++i) {
+        port_names.push_back(port_layout.name(i));
+    }
+    return {0, std::move(lines), registers, std::move(port_names),
+            instruction_set, features};
+}
+
+SyntaxTable Processor::create_syntax_table() const {
+    std::vector<std::string> port_names;
+    for (uint16_t i = 0; i < port_layout.total(); ++i) {
+        port_names.push_back(port_layout.name(i));
+    }
+    return {registers, std::move(port_names), instruction_set};
+}
+
+bool Processor::load_program(CompileResult &result) {
+    valid = result.valid;
     if (!valid) {
+        running = false;
         return false;
     }
+    instructions = std::move(result.instructions);
 
     registers.clear();
 
@@ -218,6 +298,89 @@ bool Processor::compile_program(const std::vector<std::string> lines,
     return true;
 }
 
+bool Processor::load_program(const ProgramObject &object) {
+    // Operands as the compiler writes them: registers with the size of their
+    // name, immediates that fit that size, and nothing in unused slots.
+    auto is_reg = [this](const Operand &op) {
+        return op.type == GEN_REG && op.reg < registers.count_genreg() &&
+               op.size == registers.size_genreg(op.reg);
+    };
+    auto is_port = [this](const Operand &op) {
+        return op.type == PORT && op.size == DataSize::UNKNOWN && op.port < ports.size();
+    };
+    auto is_label = [&object](const Operand &op) {
+        return op.type == LABEL && op.size == DataSize::UNKNOWN &&
+               op.label < object.size() && (op.imm_u >> 32) == 0;
+    };
+    auto is_imm = [](const Operand &op, DataSize size) {
+        if (op.type != GEN_IMM || op.size != DataSize::UNKNOWN ||
+            size < DataSize::BYTE || size > DataSize::QWORD) {
+            return false;
+        }
+        if (size == DataSize::QWORD) {
+            return true;
+        }
+        int bits = 8 << (static_cast<int>(size) - 1);
+        uint64_t max = (uint64_t{1} << bits) - 1;
+        int64_t min = -((int64_t{1} << (bits - 1)) - 1);
+        auto val = static_cast<int64_t>(op.imm_u);
+        return op.imm_u <= max || (val < 0 && val >= min);
+    };
+    auto is_unused = [](const Operand &op) {
+        return op.type == 0 && op.size == DataSize::UNKNOWN && op.imm_u == 0;
+    };
+
+    for (const Instruction& instr : object) {
+        const auto &ops = instr.operands;
+        uint32_t used = 0;
+        bool ok = instr.line < object.row_count();
+        switch (instr.id) {
+        case InstructionType::IN:
+        case InstructionType::OUT:
+            ok = ok && is_reg(ops[0]) && is_port(ops[1]);
+            used = 2;
+            break;
+        case InstructionType::MOVE_REG:
+        case InstructionType::ADD:
+        case InstructionType::SUB:
+            ok = ok && is_reg(ops[0]) && is_reg(ops[1]);
+            used = 2;
+            break;
+        case InstructionType::MOVE_IMM:
+            ok = ok && is_reg(ops[0]) && is_imm(ops[1], ops[0].size);
+            used = 2;
+            break;
+        case InstructionType::JEZ:
+            ok = ok && is_label(ops[0]);
+            used = 1;
+            break;
+        case InstructionType::NOP:
+            break;
+        default:
+            ok = false;
+        }
+        for (uint32_t i = used; ok && i < MAX_OPERANDS; ++i) {
+            ok = is_unused(ops[i]);
+        }
+        if (!ok) {
+            LOG_ERROR_CAT(LogCategory::PROCESSOR, "Invalid instruction in program object");
+            invalidate();
+            return false;
+        }
+    }
+    instructions.assign(object.begin(), object.end());
+    valid = true;
+
+    reset();
+
+    if (instructions.size() == 0) {
+        instructions.push_back({InstructionType::NOP});
+        instructions.back().line = 0;
+    }
+
+    return true;
+}
+
 void Processor::in_tick() {
     if (!valid) {
         return;
@@ -363,3 +526,11 @@ void Processor::invalidate() {
     valid = false;
     running = false;
 }
+
+uint64_t Processor::get_ticks() const noexcept { return ticks; }
+
+uint32_t Processor::get_pc() const noexcept { return pc; }
+
+const RegisterFile &Processor::get_registers() const noexcept {
+    return registers;
+}
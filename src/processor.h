@@ -3,6 +3,8 @@
 #include "instruction.h"
 #include "json.h"
 #include "compiler.h"
+#include "compile_worker.h"
+#include "program_object.h"
 #include <vector>
 #include "ports.h"
 
@@ -65,7 +67,17 @@ struct ProcessorTemplate {
       **/ 
     void validate();
 
-    bool read_from_json(const JsonObject& obj);
+    /**
+     * Reads the template from obj. Throws json::decode_exception, with the
+     * path of the offending value, if obj is not a valid template.
+     */
+    void read_from_json(const JsonObject& obj);
+
+    /**
+     * Hash of everything that affects how a program compiles and runs,
+     * used to match program objects to templates. The name is not included.
+     */
+    uint64_t fingerprint() const;
 
     Processor instantiate() const;
 };
@@ -79,6 +91,31 @@ public:
 
     bool compile_program(std::vector<std::string> lines, std::vector<ErrorMsg>& errors);
 
+    /**
+     * Creates a job that compiles lines for this processor, independent of
+     * the processor itself.
+     */
+    CompileJob create_compile_job(std::shared_ptr<const std::vector<std::string>> lines) const;
+
+    /**
+     * Creates the table used to highlight source for this processor.
+     */
+    SyntaxTable create_syntax_table() const;
+
+    /**
+     * Loads the output of a compile job, compile_program ends with this.
+     */
+    bool load_program(CompileResult& result);
+
+    /**
+     * Loads a precompiled program. The object has to be compiled for a
+     * template with the same fingerprint as this processor was created from.
+     * Returns false if the object holds anything the compiler could not
+     * have written for this processor, such as unknown registers, ports
+     * or labels, or operand sizes that do not match.
+     */
+    bool load_program(const ProgramObject& object);
+
     void in_tick();
 
     void out_tick();
@@ -96,6 +133,12 @@ public:
     void invalidate();
 
     void reset();
+
+    uint64_t get_ticks() const noexcept;
+
+    uint32_t get_pc() const noexcept;
+
+    const RegisterFile& get_registers() const noexcept;
 private:
     friend class ProcessorGui;
 
@@ -1,15 +1,17 @@
 #include "processor_gui.h"
 #include "config.h"
 #include "engine/log.h"
+#include <utility>
 
 typedef void(*Callback)(ProcessorGui*);
-typedef void(*Callback_u)(uint64_t, ProcessorGui*);
 typedef void(*Callback_i)(int64_t, ProcessorGui*);
 
 ProcessorGui::ProcessorGui() {}
-ProcessorGui::ProcessorGui(Processor* processor, ByteProblem* problem, int x, int y, WindowState* window_state) : processor{processor},
-    problem{problem}, x{x}, y{y}, window_state{window_state}, box{x, y, *window_state} {
+ProcessorGui::ProcessorGui(Processor* processor, ByteProblem* problem, Simulation* simulation, int x, int y, WindowState* window_state) : processor{processor},
+    problem{problem}, simulation{simulation}, x{x}, y{y}, window_state{window_state}, box{x, y, *window_state} {
         comps.set_window_state(window_state);
+        static_comps.set_window_state(window_state);
+        static_comps.set_cached(true);
         set_processor(processor);
 }
 
@@ -23,16 +25,17 @@ void ProcessorGui::set_processor(Processor* new_processor) {
     input_wires.clear();
     output_wires.clear();
     registers.clear();
+    shown_registers.clear();
+    shown_flags = 0;
 
     comps.clear();
+    static_comps.clear();
+    dirty = true;
 
-    Callback_u register_change = [](uint64_t reg, ProcessorGui* gui) {
-        std::string name = gui->processor->registers.to_name_genreg(reg);
-        auto val = gui->processor->registers.get_genreg(reg);
-        gui->registers[reg]->set_text(name + ": " + std::to_string(val));
-    };
+    box.set_syntax(processor->create_syntax_table());
 
-    LOG_DEBUG("Reg count: %d", processor->registers.count_genreg());
+    LOG_DEBUG("Reg count: %llu",
+              static_cast<unsigned long long>(processor->registers.count_genreg()));
     for (uint64_t i = 0; i < processor->registers.count_genreg(); ++i) {
         auto text = processor->registers.to_name_genreg(i);
         LOG_INFO("Reg name: %s", text.c_str());
@@ -48,32 +51,30 @@ void ProcessorGui::set_processor(Processor* new_processor) {
 
     for (int i = 0; i < problem->input_ports.size(); ++i) {
         const std::string name = "Input " + std::to_string(i);
-        auto box = comps.add(TextBox(10 + 110 * i, -280 + 80 / 2 - BOX_LINE_HEIGHT, 80, BOX_LINE_HEIGHT, name, *window_state));
-        problem_inputs.push_back(box);
+        static_comps.add(TextBox(10 + 110 * i, -280 + 80 / 2 - BOX_LINE_HEIGHT, 80, BOX_LINE_HEIGHT, name, *window_state));
         std::string s = problem->format_input(i);
-        box = comps.add(TextBox(10 + 110 * i, -280 + 80 / 2, 80, BOX_LINE_HEIGHT, s, *window_state));
+        auto box = comps.add(TextBox(10 + 110 * i, -280 + 80 / 2, 80, BOX_LINE_HEIGHT, s, *window_state));
         problem_inputs.push_back(box);
-        comps.add(Box(10 + 110 * i, -280, 80, 80, 2));
+        static_comps.add(Box(10 + 110 * i, -280, 80, 80, 2));
     }
 
     for (int i = 0; i < problem->output_ports.size(); ++i) {
         const std::string name = "Output " + std::to_string(i);
-        auto box = comps.add(TextBox(10 + 100 * i, BOX_SIZE + 200 + 80 / 2 - BOX_LINE_HEIGHT, 80, BOX_LINE_HEIGHT, name, *window_state));
-        problem_outputs.push_back(box);
+        static_comps.add(TextBox(10 + 100 * i, BOX_SIZE + 200 + 80 / 2 - BOX_LINE_HEIGHT, 80, BOX_LINE_HEIGHT, name, *window_state));
         std::string s = problem->format_output(i);
-        box = comps.add(TextBox(10 + 100 * i, BOX_SIZE + 200 + 80 /2, 80, BOX_LINE_HEIGHT, s, *window_state));
+        auto box = comps.add(TextBox(10 + 100 * i, BOX_SIZE + 200 + 80 /2, 80, BOX_LINE_HEIGHT, s, *window_state));
         problem_outputs.push_back(box);
-        comps.add(Box(10 + 110 * i, BOX_SIZE + 200, 80, 80, 2));
+        static_comps.add(Box(10 + 110 * i, BOX_SIZE + 200, 80, 80, 2));
     }
 
-    comps.add(Box(BOX_SIZE - 120, 0, 120, 100, 2));
+    static_comps.add(Box(BOX_SIZE - 120, 0, 120, 100, 2));
 
     int count = processor->port_layout.up;
     int pw = (BOX_SIZE - 20) / count;
     int ps = pw / 2 - 20 + 10;
     int px = 0;
     for (int i = 0; i < count; ++i, ++px) {
-        comps.add(Polygon({{ps + 10.0f + pw * i, -15.0f},
+        static_comps.add(Polygon({{ps + 10.0f + pw * i, -15.0f},
                           {ps + 40.0f + pw * i, 0.0f},
                           {ps + 30.0f + pw * i, -15.0f},
                           {static_cast<float>(ps) + pw * i, 0.0f},
@@ -81,13 +82,13 @@ void ProcessorGui::set_processor(Processor* new_processor) {
                           {ps + 10.0f + pw * i, -15.0f}
                           }))->set_border_color(0x7f, 0x7f, 0x7f, 0xff);
         std::string name = processor->port_layout.name(px);
-        comps.add(TextBox(ps + pw * i, -54, 40, 50, name, *window_state));
+        static_comps.add(TextBox(ps + pw * i, -54, 40, 50, name, *window_state));
     }
     count = processor->port_layout.right;
     pw = (BOX_SIZE - 20) / count;
     ps = pw / 2 - 20 + 10;
     for (int i = 0; i < count; ++i, ++px) {
-        comps.add(Polygon({{BOX_SIZE + 15.0f, ps + 10.0f + pw * i},
+        static_comps.add(Polygon({{BOX_SIZE + 15.0f, ps + 10.0f + pw * i},
                            {BOX_SIZE, ps + 40.0f + pw * i},
                            {BOX_SIZE + 15.0f, ps + 30.0f + pw *i},
                            {BOX_SIZE, static_cast<float>(ps) + pw * i},
@@ -95,13 +96,13 @@ void ProcessorGui::set_processor(Processor* new_processor) {
                            {BOX_SIZE + 15.0f, ps + 10.0f + pw * i}
                           }))->set_border_color(0x7f, 0x7f, 0x7f, 0xff);
         std::string name = processor->port_layout.name(px);
-        comps.add(TextBox(BOX_SIZE + 5, ps + pw * i, 50, 40, name, *window_state));
+        static_comps.add(TextBox(BOX_SIZE + 5, ps + pw * i, 50, 40, name, *window_state));
     }
     count = processor->port_layout.down;
     pw = (BOX_SIZE - 20) / count;
     ps = pw / 2 - 20 + 10;
     for (int i = 0; i < count; ++i, ++px) {
-        comps.add(Polygon({{ps + 10.0f + pw * i, BOX_SIZE + 15.0f},
+        static_comps.add(Polygon({{ps + 10.0f + pw * i, BOX_SIZE + 15.0f},
                            {ps + 40.0f + pw * i, BOX_SIZE},
                            {ps + 30.0f + pw *i, BOX_SIZE + 15.0f},
                            {static_cast<float>(ps) + pw * i, BOX_SIZE},
@@ -109,13 +110,13 @@ void ProcessorGui::set_processor(Processor* new_processor) {
                            {ps + 10.0f + pw * i, BOX_SIZE + 15.0f}
                           }))->set_border_color(0x7f, 0x7f, 0x7f, 0xff);
         std::string name = processor->port_layout.name(px);
-        comps.add(TextBox(ps + pw * i - 4, BOX_SIZE + 10, 50, 40, name, *window_state));
+        static_comps.add(TextBox(ps + pw * i - 4, BOX_SIZE + 10, 50, 40, name, *window_state));
     }
     count = processor->port_layout.left;
     pw = (BOX_SIZE - 20) / count;
     ps = pw / 2 - 20 + 10;
     for (int i = 0; i < count; ++i, ++px) {
-        comps.add(Polygon({{-15.0f, ps + 10.0f + pw * i},
+        static_comps.add(Polygon({{-15.0f, ps + 10.0f + pw * i},
                            {0.0f, ps + 40.0f + pw * i},
                            {-15.0f, ps + 30.0f + pw *i},
                            {0.0f, static_cast<float>(ps) + pw * i},
@@ -123,79 +124,125 @@ void ProcessorGui::set_processor(Processor* new_processor) {
                            {-15.0f, ps + 10.0f + pw * i}
                           }))->set_border_color(0x7f, 0x7f, 0x7f, 0xff);
         std::string name = processor->port_layout.name(px);
-        comps.add(TextBox(-54, ps + pw * i, 50, 40, name, *window_state));
+        static_comps.add(TextBox(-54, ps + pw * i, 50, 40, name, *window_state));
     }
 
-    std::vector<ErrorMsg> errors;
-    const auto& text = box.get_text();
-    processor->compile_program(text, errors);
-    box.set_errors(errors);
+    request_compile();
+}
+
+void ProcessorGui::request_compile() {
+    // The loaded program is stale until the result arrives, so it may not
+    // be run or stepped in the meantime.
+    simulation->stop();
+    processor->invalidate();
+    simulation->sync();
+    auto lines = std::make_shared<const std::vector<std::string>>(box.get_text());
+    compile_worker.submit(processor->create_compile_job(std::move(lines)));
+}
+
+void ProcessorGui::poll_compile() {
+    CompileResult result;
+    if (!compile_worker.poll(result)) {
+        return;
+    }
+    simulation->stop();
+    processor->load_program(result);
+    simulation->sync();
+    dirty = true;
+    box.set_errors(std::move(result.errors));
 }
 
 void ProcessorGui::tick(Uint64 passed) {
+    poll_compile();
     box.tick(passed);
 }
 
+namespace {
+
+void set_text_if_changed(Component<TextBox>& box, const std::string& text) {
+    if (std::as_const(box)->get_text() != text) {
+        box->set_text(text);
+    }
+}
+
+}
+
 void ProcessorGui::update() {
-    std::string s;
-    ticks->set_text("Ticks: " + std::to_string(processor->ticks));
+    if (!simulation->poll_snapshot()) {
+        return;
+    }
+    const SimSnapshot& snapshot = simulation->get_snapshot();
+    dirty = true;
+    pc = snapshot.pc;
+    ticks->set_text("Ticks: " + std::to_string(snapshot.ticks));
 
-    for (uint64_t i = 0; i < problem->input_ports.size(); ++i) { 
-        auto& port = problem_inputs[2 * i + 1];
-        if (problem->poll_input(i, s)) {
-            port->set_text(s);
-        }
+    for (std::size_t i = 0; i < problem_inputs.size() && i < snapshot.inputs.size(); ++i) {
+        set_text_if_changed(problem_inputs[i], snapshot.inputs[i]);
     }
-    for (uint64_t i = 0; i < problem->output_ports.size(); ++i) { 
-        auto& port = problem_outputs[2 * i + 1];
-        if (problem->poll_output(i, s)) {
-            port->set_text(s);
-        }
+    for (std::size_t i = 0; i < problem_outputs.size() && i < snapshot.outputs.size(); ++i) {
+        set_text_if_changed(problem_outputs[i], snapshot.outputs[i]);
     }
-    bool register_changed = false;
-    for (uint64_t i = 0; i < processor->registers.count_genreg(); ++i) {
-        if (processor->registers.poll_value_genreg(i, s)) {
-            register_changed = true;
-            registers[i]->set_text(s);
+    for (std::size_t i = 0; i < registers.size() && i < snapshot.registers.size(); ++i) {
+        if (i < shown_registers.size() && shown_registers[i] == snapshot.registers[i]) {
+            continue;
         }
+        std::string name = processor->registers.to_name_genreg(i);
+        registers[i]->set_text(name + ": " + std::to_string(snapshot.registers[i]));
     }
-    if (register_changed) {
-        bool z = processor->registers.flags & FLAG_ZERO_MASK;
-        LOG_DEBUG("Zero: %d", z);
+    shown_registers = snapshot.registers;
+    if (snapshot.flags != shown_flags) {
+        shown_flags = snapshot.flags;
+        bool z = shown_flags & FLAG_ZERO_MASK;
         flags->set_text(std::string("Z: ") + (z ? "1" : "0"));
     }
 }
 
 void ProcessorGui::render() const {
+    dirty = false;
     box.render();
+    static_comps.render(x, y);
     comps.render(x, y);
-    
-    if (processor->valid) {
-        int row = processor->instructions[processor->pc].line;
-        SDL_Rect rect = {x + 4, y + BOX_TEXT_MARGIN + BOX_LINE_HEIGHT * row + 7, 6, 6};
-        SDL_SetRenderDrawColor(gRenderer, 0xf0, 0xf0, 0xf0, 0xff);
-        SDL_RenderFillRect(gRenderer, &rect);
+
+    if (processor->valid && pc < processor->instructions.size()) {
+        int64_t row = processor->instructions[pc].line - box.get_first_row();
+        if (row >= 0 && row < BOX_VISIBLE_ROWS) {
+            SDL_Rect rect = {x + 4, y + BOX_TEXT_MARGIN + BOX_LINE_HEIGHT * static_cast<int>(row) + 7, 6, 6};
+            SDL_SetRenderDrawColor(gRenderer, 0xf0, 0xf0, 0xf0, 0xff);
+            SDL_RenderFillRect(gRenderer, &rect);
+        }
     }
 
 }
 
+bool ProcessorGui::is_dirty() const {
+    return dirty || box.is_dirty() || comps.is_dirty() || static_comps.is_dirty();
+}
+
+int ProcessorGui::idle_timeout() const {
+    // Finished compiles wake the game loop themselves.
+    return box.idle_timeout();
+}
+
 void ProcessorGui::menu_change(bool visible) {
     comps.enable_hover(!visible);
 }
 
 void ProcessorGui::set_edit_text(std::string& text) {
     box.set_text(text);
-    std::vector<ErrorMsg> errors;
-    processor->compile_program(box.get_text(), errors);
-    box.set_errors(errors);
+    request_compile();
 }
 
 const std::vector<std::string>& ProcessorGui::get_edit_text() const {
     return box.get_text();
 }
 
+uint64_t ProcessorGui::get_edit_count() const {
+    return box.get_edit_count();
+}
+
 void ProcessorGui::set_dpi(double dpi_scale) {
     comps.set_dpi(dpi_scale);
+    static_comps.set_dpi(dpi_scale);
 }
 
 bool ProcessorGui::is_pressed(int x, int y) const {
@@ -205,17 +252,20 @@ bool ProcessorGui::is_pressed(int x, int y) const {
 void ProcessorGui::set_selected(bool selected) {
     if (selected) {
         box.select();
-    } else {
-        box.unselect();
+        // Any compile in flight is for text about to be edited.
+        compile_worker.cancel();
+        return;
     }
+    box.unselect();
     if (!processor->is_valid()) {
-        std::vector<ErrorMsg> errors;
-        const auto& text = box.get_text();
-        processor->compile_program(text, errors);
-        box.set_errors(errors);
+        request_compile();
     }
 }
 
+void ProcessorGui::scroll(int rows) {
+    box.scroll(rows);
+}
+
 void ProcessorGui::input_char(char c) {
     box.input_char(c);
 }
@@ -3,6 +3,8 @@
 #include "processor.h"
 #include "problem.h"
 #include "editbox.h"
+#include "compile_worker.h"
+#include "simulation.h"
 #include "engine/ui.h"
 
 /*
@@ -13,7 +15,7 @@ class ProcessorGui {
 public:
     ProcessorGui();
 
-    ProcessorGui(Processor* ptr, ByteProblem* problem, int x, int y, WindowState* window_state);
+    ProcessorGui(Processor* ptr, ByteProblem* problem, Simulation* simulation, int x, int y, WindowState* window_state);
     ProcessorGui(ProcessorGui&& other) = delete;
     ProcessorGui(const ProcessorGui& other) = delete;
     ProcessorGui& operator=(ProcessorGui&& other) = delete;
@@ -21,10 +23,16 @@ public:
 
     void render() const;
 
-    // Call when something on the processor behind the gui might have changed
+    // Returns true if anything changed since the last render.
+    bool is_dirty() const;
+
+    // Milliseconds until tick has to be called again, -1 if not needed.
+    int idle_timeout() const;
+
+    // Shows the latest snapshot of simulation, if there is a new one.
     void update();
 
-    // Call regularly for cursor animation etc.
+    // Call regularly for cursor animation and compile results.
     void tick(Uint64 passed);
 
     void set_processor(Processor* processor);
@@ -41,16 +49,31 @@ public:
 
     void input_char(char c);
 
+    // Scrolls the edit text by rows.
+    void scroll(int rows);
+
     void handle_keypress(SDL_Keycode key);
 
     const std::vector<std::string>& get_edit_text() const;
+
+    uint64_t get_edit_count() const;
 private:
+    // Hands a snapshot of the edit text to the compile worker. The processor
+    // can not run until poll_compile applies the result.
+    void request_compile();
+
+    // Applies a finished compile, if any.
+    void poll_compile();
+
     std::unique_ptr<EventScope> event_scope {};
 
+    CompileWorker compile_worker {};
+
     Editbox box;
 
     Processor* processor {nullptr};
     ByteProblem* problem {nullptr};
+    Simulation* simulation {nullptr};
 
     WindowState* window_state {nullptr};
 
@@ -68,7 +91,18 @@ private:
     Component<TextBox> flags {};
     Component<TextBox> ticks {};
 
+    // Values from the last shown snapshot.
+    std::vector<uint64_t> shown_registers {};
+    flag_t shown_flags {0};
+    uint32_t pc {0};
+
+    // Values that change while running.
     Components comps {};
+    // Borders, ports and labels, only changed by set_processor.
+    Components static_comps {};
+
+    // Set when the pc marker might have moved.
+    mutable bool dirty {true};
 };
 
 #endif
@@ -865,6 +865,10 @@ void ProcessorMenu::render() {
     instr_comps.render(0, 0);
 }
 
+bool ProcessorMenu::is_dirty() const {
+    return OverlayMenu::is_dirty() || instr_comps.is_dirty();
+}
+
 void ProcessorMenu::handle_up(SDL_Keycode key, Uint8 mouse) {
     Menu::handle_up(key, mouse);
     if (mouse == SDL_BUTTON_LEFT) {
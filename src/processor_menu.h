@@ -14,6 +14,8 @@ public:
 
     void render() override;
 
+    bool is_dirty() const override;
+
     void resume() override;
 
     void handle_down(SDL_Keycode key, Uint8 mouse) override;
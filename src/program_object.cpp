@@ -0,0 +1,265 @@
+#include "program_object.h"
+#include "compiler.h"
+#include <SDL.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr char MAGIC[8] = {'P', 'A', 'S', 'M', 'O', 'B', 'J', '\0'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static_assert(sizeof(ProgramObjectHeader) % 8 == 0,
+              "Header must keep sections aligned");
+static_assert(alignof(Instruction) <= 8, "Instruction alignment too large");
+
+namespace {
+
+uint64_t fnv1a(const unsigned char *data, std::size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+constexpr uint64_t align_up(uint64_t v) { return (v + 7) & ~uint64_t{7}; }
+
+} // namespace
+
+void write_program_object(const std::string &path,
+                          const std::vector<Instruction> &instructions,
+                          uint32_t source_rows, uint64_t fingerprint) {
+    ProgramObjectHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = PROGRAM_OBJECT_VERSION;
+    header.header_size = sizeof(ProgramObjectHeader);
+    header.instruction_size = sizeof(Instruction);
+    header.byte_order = BYTE_ORDER_MARK;
+    header.fingerprint = fingerprint;
+    header.instruction_count = instructions.size();
+    header.instruction_offset = sizeof(ProgramObjectHeader);
+    header.line_count = source_rows;
+    header.line_offset = align_up(header.instruction_offset +
+                                  instructions.size() * sizeof(Instruction));
+
+    std::size_t body_size =
+        header.line_offset + source_rows * sizeof(uint32_t) - sizeof(header);
+    // The body starts right after the header, offsets are from file start.
+    std::vector<unsigned char> body(body_size, 0);
+    unsigned char *out = &body[header.instruction_offset - sizeof(header)];
+    for (const Instruction &instr : instructions) {
+        // Copy member by member into zeroed storage, so padding, unused
+        // operands and unused union bytes are zero and equal programs
+        // give equal files.
+        Instruction clean;
+        std::memset(&clean, 0, sizeof(clean));
+        clean.id = instr.id;
+        for (uint32_t i = 0; i < MAX_OPERANDS; ++i) {
+            const Operand &op = instr.operands[i];
+            Operand &dest = clean.operands[i];
+            dest.type = op.type;
+            dest.size = op.size;
+            if (op.type == LABEL) {
+                dest.label = op.label;
+            } else if (op.type != 0) {
+                dest.imm_u = op.imm_u;
+            }
+        }
+        clean.line = instr.line;
+        std::memcpy(out, &clean, sizeof(clean));
+        out += sizeof(clean);
+    }
+
+    std::vector<uint32_t> lines(source_rows, PROGRAM_NO_INSTRUCTION);
+    for (std::size_t i = 0; i < instructions.size(); ++i) {
+        uint64_t row = instructions[i].line;
+        if (row < source_rows && lines[row] == PROGRAM_NO_INSTRUCTION) {
+            lines[row] = static_cast<uint32_t>(i);
+        }
+    }
+    if (!lines.empty()) {
+        std::memcpy(&body[header.line_offset - sizeof(header)], lines.data(),
+                    lines.size() * sizeof(uint32_t));
+    }
+    header.checksum = fnv1a(body.data(), body.size());
+
+    SDL_RWops *file = SDL_RWFromFile(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw program_object_exception("Failed opening '" + path +
+                                       "': " + SDL_GetError());
+    }
+    bool ok = SDL_RWwrite(file, &header, sizeof(header), 1) == 1;
+    if (ok && !body.empty()) {
+        ok = SDL_RWwrite(file, body.data(), body.size(), 1) == 1;
+    }
+    if (SDL_RWclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        throw program_object_exception("Failed writing '" + path + "'");
+    }
+}
+
+ProgramObject::ProgramObject(const std::string &path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw program_object_exception("Failed opening '" + path + "'");
+    }
+    file_handle = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        unmap();
+        throw program_object_exception("Failed reading size of '" + path + "'");
+    }
+    data_size = static_cast<std::size_t>(size.QuadPart);
+    if (data_size >= sizeof(ProgramObjectHeader)) {
+        map_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (map_handle != nullptr) {
+            data = MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (data == nullptr) {
+            unmap();
+            throw program_object_exception("Failed mapping '" + path + "'");
+        }
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw program_object_exception("Failed opening '" + path +
+                                       "': " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw program_object_exception("Failed reading size of '" + path + "'");
+    }
+    data_size = static_cast<std::size_t>(st.st_size);
+    if (data_size >= sizeof(ProgramObjectHeader)) {
+        void *ptr = mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close(fd);
+            throw program_object_exception("Failed mapping '" + path +
+                                           "': " + std::strerror(errno));
+        }
+        data = ptr;
+    }
+    close(fd);
+#endif
+    if (data == nullptr) {
+        unmap();
+        throw program_object_exception("'" + path + "' is not a program object");
+    }
+
+    const auto *h = static_cast<const ProgramObjectHeader *>(data);
+    const char *error = nullptr;
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = "is not a program object";
+    } else if (h->version != PROGRAM_OBJECT_VERSION ||
+               h->header_size != sizeof(ProgramObjectHeader)) {
+        error = "has an unsupported version";
+    } else if (h->instruction_size != sizeof(Instruction) ||
+               h->byte_order != BYTE_ORDER_MARK) {
+        error = "was written for a different platform";
+    } else if (h->instruction_offset % 8 != 0 || h->line_offset % 8 != 0 ||
+               h->instruction_offset < sizeof(ProgramObjectHeader) ||
+               h->instruction_offset > data_size ||
+               h->instruction_count >
+                   (data_size - h->instruction_offset) / sizeof(Instruction) ||
+               h->line_offset < h->instruction_offset +
+                                    h->instruction_count * sizeof(Instruction) ||
+               h->line_offset > data_size ||
+               h->line_count > (data_size - h->line_offset) / sizeof(uint32_t)) {
+        error = "is truncated";
+    }
+    if (error != nullptr) {
+        unmap();
+        throw program_object_exception("'" + path + "' " + error);
+    }
+
+    header = h;
+    if (!verify()) {
+        unmap();
+        throw program_object_exception("'" + path + "' is corrupted");
+    }
+    const auto *base = static_cast<const unsigned char *>(data);
+    instructions = reinterpret_cast<const Instruction *>(base + h->instruction_offset);
+    lines = reinterpret_cast<const uint32_t *>(base + h->line_offset);
+}
+
+ProgramObject::ProgramObject(ProgramObject &&other) noexcept {
+    *this = std::move(other);
+}
+
+ProgramObject &ProgramObject::operator=(ProgramObject &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        std::swap(header, other.header);
+        std::swap(instructions, other.instructions);
+        std::swap(lines, other.lines);
+        std::swap(data, other.data);
+        std::swap(data_size, other.data_size);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(map_handle, other.map_handle);
+#endif
+    }
+    return *this;
+}
+
+ProgramObject::~ProgramObject() { unmap(); }
+
+bool ProgramObject::verify() const {
+    if (header == nullptr) {
+        return false;
+    }
+    const auto *body = static_cast<const unsigned char *>(data) + sizeof(ProgramObjectHeader);
+    std::size_t size = header->line_offset + header->line_count * sizeof(uint32_t) -
+                       sizeof(ProgramObjectHeader);
+    return fnv1a(body, size) == header->checksum;
+}
+
+uint32_t ProgramObject::instruction_at_row(std::size_t row) const {
+    if (row >= header->line_count) {
+        return PROGRAM_NO_INSTRUCTION;
+    }
+    return lines[row];
+}
+
+void ProgramObject::unmap() {
+#ifdef _WIN32
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+    if (map_handle != nullptr) {
+        CloseHandle(map_handle);
+    }
+    if (file_handle != nullptr) {
+        CloseHandle(file_handle);
+    }
+    map_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (data != nullptr) {
+        munmap(const_cast<void *>(data), data_size);
+    }
+#endif
+    data = nullptr;
+    data_size = 0;
+    header = nullptr;
+    instructions = nullptr;
+    lines = nullptr;
+}
@@ -0,0 +1,123 @@
+#ifndef PROC_ASM_PROGRAM_OBJECT_H
+#define PROC_ASM_PROGRAM_OBJECT_H
+
+#include "engine/exceptions.h"
+#include "instruction.h"
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * program_object_exception, for when writing or mapping a program object
+ * fails.
+ */
+class program_object_exception : public base_exception {
+public:
+    explicit program_object_exception(std::string msg) : base_exception(std::move(msg)){};
+};
+
+constexpr uint32_t PROGRAM_OBJECT_VERSION = 1;
+
+// Value of the line map for source rows without an instruction.
+constexpr uint32_t PROGRAM_NO_INSTRUCTION = UINT32_MAX;
+
+static_assert(std::is_trivially_copyable_v<Instruction>,
+              "Instruction is stored as raw bytes in program objects");
+
+/**
+ * On-disk header of a compiled program. The file layout is:
+ * header, instructions (raw Instruction structs), line map (one uint32_t per
+ * source row holding the index of its instruction).
+ * Sections are 8 byte aligned so they can be used straight from a mapping.
+ */
+struct ProgramObjectHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // sizeof(Instruction) and a byte order marker, objects are only valid on
+    // the same ABI they were written on.
+    uint32_t instruction_size;
+    uint32_t byte_order;
+    // ProcessorTemplate::fingerprint() of the template compiled for.
+    uint64_t fingerprint;
+    uint64_t instruction_count;
+    uint64_t instruction_offset;
+    uint64_t line_count;
+    uint64_t line_offset;
+    // FNV-1a hash of all bytes following the header.
+    uint64_t checksum;
+};
+
+/**
+ * Writes a compiled program to path. Throws program_object_exception on
+ * failure.
+ *
+ * @param path the file to write.
+ * @param instructions the decoded instruction stream.
+ * @param source_rows the number of rows in the source text.
+ * @param fingerprint the fingerprint of the template compiled for.
+ */
+void write_program_object(const std::string &path,
+                          const std::vector<Instruction> &instructions,
+                          uint32_t source_rows, uint64_t fingerprint);
+
+/**
+ * A read-only memory mapping of a program object file.
+ * Nothing is parsed, instructions and line map point into the mapping.
+ * The instructions are not validated, Processor::load_program does that.
+ */
+class ProgramObject {
+public:
+    ProgramObject() = default;
+
+    /**
+     * Maps the file at path, validating the header and the checksum.
+     * Throws program_object_exception on failure.
+     */
+    explicit ProgramObject(const std::string &path);
+
+    ProgramObject(const ProgramObject &) = delete;
+    ProgramObject &operator=(const ProgramObject &) = delete;
+    ProgramObject(ProgramObject &&other) noexcept;
+    ProgramObject &operator=(ProgramObject &&other) noexcept;
+
+    ~ProgramObject();
+
+    /**
+     * Returns true if the checksum matches the content.
+     * Reads the full file.
+     */
+    bool verify() const;
+
+    uint64_t fingerprint() const { return header->fingerprint; }
+
+    const Instruction *begin() const { return instructions; }
+    const Instruction *end() const { return instructions + header->instruction_count; }
+
+    std::size_t size() const { return header->instruction_count; }
+
+    /**
+     * Returns the instruction index compiled from row, or
+     * PROGRAM_NO_INSTRUCTION.
+     */
+    uint32_t instruction_at_row(std::size_t row) const;
+
+    std::size_t row_count() const { return header->line_count; }
+
+private:
+    void unmap();
+
+    const ProgramObjectHeader *header {nullptr};
+    const Instruction *instructions {nullptr};
+    const uint32_t *lines {nullptr};
+
+    const void *data {nullptr};
+    std::size_t data_size {0};
+#ifdef _WIN32
+    void *file_handle {nullptr};
+    void *map_handle {nullptr};
+#endif
+};
+
+#endif
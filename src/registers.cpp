@@ -29,7 +29,6 @@ void RegisterFile::set_genreg(uint64_t ix, DataSize size, uint64_t val) {
     gen_registers[ix].changed = true;
     flags = (flags & ~FLAG_ZERO_MASK) |
             ((gen_registers[ix].val == 0) << FLAG_ZERO_IX);
-    LOG_DEBUG("Flags: %d", flags);
 }
 
 uint64_t RegisterFile::count_genreg() const { return gen_registers.size(); }
@@ -70,6 +69,10 @@ const std::string &RegisterFile::to_name_genreg(uint64_t ix) const {
     return genreg_names[ix].first;
 }
 
+DataSize RegisterFile::size_genreg(uint64_t ix) const {
+    return genreg_names[ix].second;
+}
+
 bool RegisterFile::poll_value_genreg(uint64_t ix, std::string &s) {
     if (gen_registers[ix].changed) {
         s = to_name_genreg(ix) + ": " + std::to_string(gen_registers[ix].val);
@@ -52,6 +52,8 @@ public:
 
     const std::string &to_name_genreg(uint64_t ix) const;
 
+    DataSize size_genreg(uint64_t ix) const;
+
     bool poll_value_genreg(uint64_t ix, std::string &s);
 
     flag_t enabled_flags;
@@ -0,0 +1,235 @@
+#include "simulation.h"
+#include "engine/log.h"
+#include "engine/game.h"
+#include <algorithm>
+#include <cstdint>
+
+// Longest time spent ticking before publishing a snapshot.
+constexpr auto MAX_BATCH_TIME = std::chrono::milliseconds(5);
+
+// Ticks run between checks for commands and the batch time.
+constexpr uint64_t TICKS_PER_CHECK = 1024;
+
+Simulation::~Simulation() {
+    if (thread.joinable()) {
+        send(CommandType::QUIT, 0, false);
+        thread.join();
+    }
+}
+
+void Simulation::attach(Processor *new_processor, ByteProblem *new_problem) {
+    processor = new_processor;
+    problem = new_problem;
+    sync();
+}
+
+void Simulation::send(CommandType type, uint64_t value, bool wait, RunTarget target) {
+    std::unique_lock<std::mutex> lock{mutex};
+    if (!thread.joinable()) {
+        thread = std::thread{&Simulation::run, this};
+    }
+    uint64_t seq = ++sent_seq;
+    commands.push_back({type, value, target, seq});
+    interrupted = true;
+    cond.notify_one();
+    if (wait) {
+        processed_cond.wait(lock, [this, seq]() { return processed_seq >= seq; });
+    }
+}
+
+void Simulation::start(RunTarget target) {
+    if (is_running() || !processor->is_valid()) {
+        return;
+    }
+    stop();
+    if (is_reached(target)) {
+        return;
+    }
+    running = true;
+    processor->start();
+    send(CommandType::START, 0, false, target);
+}
+
+void Simulation::stop() {
+    if (!running) {
+        return;
+    }
+    if (!reached_target.load(std::memory_order_acquire)) {
+        send(CommandType::STOP, 0, true);
+    }
+    reached_target = false;
+    processor->stop();
+    running = false;
+}
+
+void Simulation::step() {
+    if (running || !processor->is_valid()) {
+        return;
+    }
+    tick_once();
+    publish();
+}
+
+void Simulation::sync() {
+    if (running) {
+        return;
+    }
+    publish();
+}
+
+void Simulation::set_tick_rate(uint64_t ticks_per_second) {
+    tick_rate = ticks_per_second;
+    if (thread.joinable()) {
+        send(CommandType::SET_RATE, tick_rate, false);
+    }
+}
+
+bool Simulation::is_reached(const RunTarget &target) const {
+    switch (target.type) {
+    case RunTarget::NONE:
+        return false;
+    case RunTarget::TICKS:
+        return processor->get_ticks() >= target.value;
+    }
+    return false;
+}
+
+void tick_simulation(Processor &processor, ByteProblem &problem) {
+    problem.in_tick();
+    processor.in_tick();
+
+    problem.out_tick();
+    processor.out_tick();
+
+    problem.clock_tick();
+    processor.clock_tick();
+}
+
+void Simulation::tick_once() { tick_simulation(*processor, *problem); }
+
+void Simulation::publish() {
+    SimSnapshot &snapshot = snapshots.back();
+    const RegisterFile &registers = processor->get_registers();
+    snapshot.ticks = processor->get_ticks();
+    snapshot.pc = processor->get_pc();
+    snapshot.flags = registers.flags;
+    snapshot.registers.resize(registers.count_genreg());
+    for (uint64_t i = 0; i < registers.count_genreg(); ++i) {
+        snapshot.registers[i] = registers.get_genreg(i);
+    }
+    snapshot.inputs.resize(problem->input_count());
+    for (std::size_t i = 0; i < problem->input_count(); ++i) {
+        snapshot.inputs[i] = problem->format_input(i);
+    }
+    snapshot.outputs.resize(problem->output_count());
+    for (std::size_t i = 0; i < problem->output_count(); ++i) {
+        snapshot.outputs[i] = problem->format_output(i);
+    }
+    snapshots.publish();
+}
+
+void Simulation::run() {
+    typedef std::chrono::steady_clock Clock;
+    bool active = false;
+    uint64_t rate;
+    RunTarget target{};
+    // Ticks run since start, which is moved forward if ticking falls behind.
+    Clock::time_point start;
+    uint64_t done = 0;
+
+    std::unique_lock<std::mutex> lock{mutex};
+    rate = tick_rate;
+    while (true) {
+        interrupted = false;
+        while (!commands.empty()) {
+            Command command = commands.front();
+            commands.pop_front();
+            switch (command.type) {
+            case CommandType::START:
+                active = true;
+                target = command.target;
+                start = Clock::now();
+                done = 0;
+                break;
+            case CommandType::STOP:
+                if (active) {
+                    active = false;
+                    publish();
+                }
+                break;
+            case CommandType::SET_RATE:
+                rate = command.value;
+                start = Clock::now();
+                done = 0;
+                break;
+            case CommandType::QUIT:
+                return;
+            }
+            processed_seq = command.seq;
+        }
+        processed_cond.notify_all();
+
+        if (!active) {
+            cond.wait(lock, [this]() { return !commands.empty(); });
+            continue;
+        }
+
+        uint64_t batch;
+        uint64_t batch_limit;
+        if (rate == UNLIMITED) {
+            // Only limited by MAX_BATCH_TIME.
+            batch = batch_limit = UINT64_MAX;
+        } else {
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+            uint64_t due = static_cast<uint64_t>(elapsed.count() * rate) - done;
+            if (due == 0) {
+                auto next = start + std::chrono::duration<double>(
+                                        static_cast<double>(done + 1) / rate);
+                cond.wait_until(lock, std::chrono::time_point_cast<Clock::duration>(next),
+                                [this]() { return !commands.empty(); });
+                continue;
+            }
+            batch_limit = std::max<uint64_t>(rate * MAX_BATCH_TIME.count() / 1000, 1);
+            batch = std::min(due, batch_limit);
+        }
+        if (target.type == RunTarget::TICKS) {
+            batch = std::min(batch, target.value - processor->get_ticks());
+        }
+
+        lock.unlock();
+        auto batch_end = Clock::now() + MAX_BATCH_TIME;
+        uint64_t ran = 0;
+        bool reached = false;
+        while (ran < batch && !reached) {
+            uint64_t n = std::min(batch - ran, TICKS_PER_CHECK);
+            for (uint64_t i = 0; i < n; ++i) {
+                tick_once();
+            }
+            ran += n;
+            reached = is_reached(target);
+            if (interrupted.load(std::memory_order_relaxed) || Clock::now() >= batch_end) {
+                break;
+            }
+        }
+        publish();
+        lock.lock();
+
+        if (reached) {
+            active = false;
+            reached_target.store(true, std::memory_order_release);
+            // The gui might be waiting for events.
+            wake_game_loop();
+            continue;
+        }
+
+        done += ran;
+        if (rate != UNLIMITED && batch == batch_limit && ran < batch) {
+            // Can not keep up, drop the backlog instead of trying to catch up.
+            LOG_DEBUG_CAT(LogCategory::PROCESSOR,
+                          "Simulation can not keep up with %llu ticks per second",
+                          static_cast<unsigned long long>(rate));
+            start = Clock::now();
+            done = 0;
+        }
+    }
+}
@@ -0,0 +1,212 @@
+#ifndef PROC_ASM_SIMULATION_H
+#define PROC_ASM_SIMULATION_H
+
+#include "processor.h"
+#include "problem.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * State of a running simulation, as shown by the gui.
+ */
+struct SimSnapshot {
+    uint64_t ticks {0};
+    uint32_t pc {0};
+    flag_t flags {0};
+
+    std::vector<uint64_t> registers {};
+
+    // Formatted problem ports
+    std::vector<std::string> inputs {};
+    std::vector<std::string> outputs {};
+};
+
+/**
+ * Where a simulation stops by itself.
+ */
+struct RunTarget {
+    enum Type {
+        // Run until stopped
+        NONE,
+        // Run until the processor has run value ticks
+        TICKS
+    } type = NONE;
+    uint64_t value = 0;
+};
+
+/**
+ * Runs a single tick of processor and problem. Everything that simulates
+ * ticks goes through here, so they all run them in the same order.
+ */
+void tick_simulation(Processor &processor, ByteProblem &problem);
+
+/**
+ * Triple buffer for handing values from one producer thread to one consumer
+ * thread. Neither side ever waits for the other, the consumer always gets
+ * the latest published value.
+ */
+template <class T> class TripleBuffer {
+public:
+    /**
+     * The buffer to fill before calling publish. Only used by the producer.
+     */
+    T &back() { return buffers[back_ix]; }
+
+    /**
+     * Makes the back buffer visible to the consumer.
+     */
+    void publish() {
+        back_ix = middle.exchange(back_ix | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /**
+     * Swaps in the latest published buffer, if there is one newer than front.
+     * Only used by the consumer.
+     *
+     * @return true if front changed.
+     */
+    bool poll() {
+        if (!(middle.load(std::memory_order_acquire) & NEW_BIT)) {
+            return false;
+        }
+        front_ix = middle.exchange(front_ix, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * The latest buffer received by poll. Only used by the consumer.
+     */
+    const T &front() const { return buffers[front_ix]; }
+
+private:
+    static constexpr uint8_t NEW_BIT = 4;
+    static constexpr uint8_t INDEX_MASK = 3;
+
+    T buffers[3] {};
+    uint8_t front_ix = 0;
+    std::atomic<uint8_t> middle {1};
+    uint8_t back_ix = 2;
+};
+
+/**
+ * Runs a processor and problem on a background thread at a fixed rate,
+ * or as fast as possible, publishing a SimSnapshot after every batch of ticks.
+ * A batch never runs longer than a fraction of a frame.
+ *
+ * While running, the processor and problem belong to the simulation thread.
+ * After stop returns they belong to the caller again, and may be changed
+ * freely until the next start.
+ */
+class Simulation {
+public:
+    Simulation() = default;
+
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    ~Simulation();
+
+    /**
+     * Sets what to simulate. Only call while stopped.
+     */
+    void attach(Processor *processor, ByteProblem *problem);
+
+    // Tick rate for running as fast as possible.
+    static constexpr uint64_t UNLIMITED = 0;
+
+    /**
+     * Starts running, if the processor has a valid program, until stopped or
+     * target is reached. The thread is started on first use.
+     */
+    void start(RunTarget target = {});
+
+    /**
+     * Stops running. Returns when the simulation thread no longer uses
+     * the processor or problem.
+     */
+    void stop();
+
+    /**
+     * Returns false once stopped, including when the run target was reached.
+     */
+    bool is_running() const noexcept {
+        return running && !reached_target.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Runs a single tick on the calling thread and publishes it.
+     * Does nothing while running.
+     */
+    void step();
+
+    /**
+     * Publishes the current state, after it was changed while stopped.
+     */
+    void sync();
+
+    /**
+     * Sets the number of ticks per second, or UNLIMITED.
+     */
+    void set_tick_rate(uint64_t ticks_per_second);
+
+    uint64_t get_tick_rate() const noexcept { return tick_rate; }
+
+    /**
+     * Fetches the latest snapshot, if a new one was published.
+     *
+     * @return true if get_snapshot changed.
+     */
+    bool poll_snapshot() { return snapshots.poll(); }
+
+    const SimSnapshot &get_snapshot() const { return snapshots.front(); }
+
+private:
+    enum class CommandType { START, STOP, SET_RATE, QUIT };
+
+    struct Command {
+        CommandType type;
+        uint64_t value;
+        RunTarget target;
+        uint64_t seq;
+    };
+
+    // Queues a command, waiting for it to be processed if wait is true.
+    void send(CommandType type, uint64_t value, bool wait, RunTarget target = {});
+
+    bool is_reached(const RunTarget &target) const;
+
+    void run();
+
+    void tick_once();
+
+    void publish();
+
+    Processor *processor {nullptr};
+    ByteProblem *problem {nullptr};
+
+    bool running = false;
+    // Set by the simulation thread when it stopped at its run target.
+    std::atomic<bool> reached_target {false};
+    uint64_t tick_rate {1000};
+
+    std::thread thread {};
+    std::mutex mutex {};
+    std::condition_variable cond {};
+    std::condition_variable processed_cond {};
+
+    std::deque<Command> commands {};
+    // Set when commands are queued, checked while ticking without the lock.
+    std::atomic<bool> interrupted {false};
+    uint64_t sent_seq {0};
+    uint64_t processed_seq {0};
+
+    TripleBuffer<SimSnapshot> snapshots {};
+};
+
+#endif